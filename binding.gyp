@@ -3,8 +3,15 @@
     'target_name': 'ffi_bindings',
     'sources': [
       'src/ffi.cc',
+      'src/async_limits.cc',
+      'src/call_chain.cc',
+      'src/call_jit.cc',
+      'src/call_plan.cc',
+      'src/call_ring.cc',
+      'src/call_thunks.cc',
       'src/callback_info.cc',
-      'src/threaded_callback_invokation.cc'
+      'src/threaded_callback_invokation.cc',
+      'src/worker_pool.cc'
     ],
     'include_dirs': [
       "<!@(node -p \"require('node-addon-api').include\")",
@@ -387,6 +387,42 @@ examine_argument (ffi_type *type, enum x86_64_reg_class classes[MAX_CLASSES],
   return n;
 }
 
+/* node-ffi-napi: expose examine_argument() to the call stub generator
+   (src/call_jit.cc), so that it passes values exactly like ffi_call() does.
+   Stores one class per eightbyte: 0 for none, 1 for a general purpose
+   register, 2 for an SSE register and -1 for anything else (x87, SSEUP).
+   Returns the number of eightbytes, or zero if TYPE is passed in memory.  */
+
+int
+ffi_unix64_classify (ffi_type *type, int in_return, int classes[4])
+{
+  enum x86_64_reg_class c[MAX_CLASSES];
+  int ngpr, nsse;
+  size_t i, n;
+
+  n = examine_argument (type, c, in_return != 0, &ngpr, &nsse);
+  for (i = 0; i < n; i++)
+    switch (c[i])
+      {
+      case X86_64_NO_CLASS:
+	classes[i] = 0;
+	break;
+      case X86_64_INTEGER_CLASS:
+      case X86_64_INTEGERSI_CLASS:
+	classes[i] = 1;
+	break;
+      case X86_64_SSE_CLASS:
+      case X86_64_SSESF_CLASS:
+      case X86_64_SSEDF_CLASS:
+	classes[i] = 2;
+	break;
+      default:
+	classes[i] = -1;
+	break;
+      }
+  return (int) n;
+}
+
 /* Perform machine dependent cif processing.  */
 
 #ifndef __ILP32__
@@ -7,13 +7,67 @@ const assert = require('assert');
 const debug = require('debug')('ffi:_ForeignFunction');
 const ref = require('ref-napi');
 const bindings = require('./bindings');
+const CallPlan = require('./call_plan');
+const Limiter = require('./limiter');
 const POINTER_SIZE = ref.sizeof.pointer;
 const FFI_ARG_SIZE = bindings.FFI_ARG_SIZE;
+const KINDS = bindings.VALUE_KINDS;
+const POLICIES = bindings.ERROR_POLICIES;
+const PRIORITIES = [ 'interactive', 'normal', 'bulk' ];
 
 
-function ForeignFunction (cif, funcPtr, returnType, argTypes) {
+function ForeignFunction (cif, funcPtr, returnType, argTypes, options) {
   debug('creating new ForeignFunction', funcPtr);
 
+  // return 64-bit integers as BigInts instead of Numbers/Strings
+  const bigint = !!(options && options.bigint);
+
+  // capture `errno` right after every call, and/or throw an Error carrying it
+  // when the return value signals a failure (see ErrorOptions in src/ffi.h)
+  const errorPolicy = options && options.errorPolicy;
+  const captureErrno = !!(options && options.errno) || !!errorPolicy;
+  const name = options && options.name;
+  assert(!errorPolicy || POLICIES.hasOwnProperty(errorPolicy),
+    'errorPolicy must be one of: ' + Object.keys(POLICIES).join(', '));
+  const errorFlags = (captureErrno ? 1 : 0) | (errorPolicy ? POLICIES[errorPolicy] << 1 : 0);
+
+  // async calls run on the FFI worker pool, unless `pool: 'uv'` puts them on
+  // the libuv threadpool (shared with fs, dns, zlib, ...)
+  const pool = (options && options.pool) || 'ffi';
+  assert(pool === 'ffi' || pool === 'uv', 'pool must be "ffi" or "uv"');
+  const uvPool = pool === 'uv';
+
+  // or: run them on the dedicated thread of this executor, one at a time
+  const executor = options && options.executor;
+  assert(executor === undefined || executor === null ||
+    (typeof executor === 'string' && executor.length > 0),
+    'executor must be a non-empty String');
+  assert(!executor || !uvPool, 'the "executor" and "pool" options conflict');
+
+  // receives the completions of `async()` calls in batches, as a flat Array
+  // of [tag, err, result] triples, instead of one callback per call
+  const completionHandler = options && options.completionHandler;
+  assert(!completionHandler || typeof completionHandler === 'function',
+    'completionHandler must be a function');
+
+  // drop async calls that haven't started this many milliseconds after they
+  // were made (can be overridden per call)
+  const timeout = (options && options.timeout) || 0;
+  assert(typeof timeout === 'number' && timeout >= 0,
+    'timeout must be a non-negative Number');
+
+  // the scheduling class of async calls on the FFI worker pool: workers
+  // prefer "interactive" calls over "normal" ones, and those over "bulk" ones
+  const priority = (options && options.priority) || 'normal';
+  assert(PRIORITIES.indexOf(priority) !== -1,
+    'priority must be one of: ' + PRIORITIES.join(', '));
+
+  // caps on the async calls of this function (and of the others sharing
+  // the Limiter), besides the global ones
+  const limiter = options && options.limiter;
+  assert(!limiter || limiter instanceof Limiter, 'limiter must be a Limiter');
+  const limits = limiter ? limiter._limits : undefined;
+
   const numArgs = argTypes.length;
   const argsArraySize = numArgs * POINTER_SIZE;
 
@@ -23,13 +77,37 @@ function ForeignFunction (cif, funcPtr, returnType, argTypes) {
   const resultSize = returnType.size >= ref.sizeof.long ? returnType.size : FFI_ARG_SIZE;
   assert(resultSize > 0);
 
+  // the machine code stub calling functions of this signature, when the
+  // platform supports them (see src/call_jit.cc); shared by all the
+  // functions using the same cif
+  if (cif.callStub === undefined) {
+    cif.callStub = bindings.ffi_call_stub(cif);
+  }
+  const callStub = cif.callStub;
+
+  // return values that can be decoded natively don't need a result Buffer
+  const returnKind = CallPlan.kindOf(returnType);
+  const nativeResult = returnKind !== -1 && returnKind !== KINDS.pointer;
+  const is64Bit = returnKind === KINDS.int64 || returnKind === KINDS.uint64;
+  assert(!errorPolicy || (returnKind !== -1 && returnKind !== KINDS.void),
+    'errorPolicy requires a number, bool, pointer or string return type');
+
   /**
    * This is the actual JS function that gets returned.
    * It handles marshalling input arguments into C values,
-   * and unmarshalling the return value back into a JS value
+   * and unmarshalling the return value back into a JS value.
+   *
+   * When all of the types can be converted natively, the CallPlan's function
+   * (implemented in C++) is used instead.
    */
 
-  const proxy = function () {
+  const plan = CallPlan(cif, funcPtr, returnType, argTypes, bigint, errorFlags,
+    name, uvPool, completionHandler, executor, timeout, priority, limits);
+  if (completionHandler && !plan) {
+    throw new TypeError('completionHandler requires number, bool, pointer ' +
+        'or string types');
+  }
+  const proxy = plan || function () {
     debug('invoking proxy function');
 
     if (arguments.length !== numArgs) {
@@ -37,8 +115,7 @@ function ForeignFunction (cif, funcPtr, returnType, argTypes) {
           ' arguments, got ' + arguments.length);
     }
 
-    // storage buffers for input arguments and the return value
-    const result = Buffer.alloc(resultSize);
+    // storage buffer for input arguments
     const argsList = Buffer.alloc(argsArraySize);
 
     // write arguments to storage areas
@@ -57,31 +134,102 @@ function ForeignFunction (cif, funcPtr, returnType, argTypes) {
       throw e;
     }
 
+    if (nativeResult) {
+      return bindings.ffi_call_value(cif, funcPtr, argsList, returnKind, bigint,
+        callStub, errorFlags, name);
+    }
+
     // invoke the `ffi_call()` function
-    bindings.ffi_call(cif, funcPtr, result, argsList);
+    const result = Buffer.alloc(resultSize);
+    bindings.ffi_call(cif, funcPtr, result, argsList, callStub, errorFlags, name, returnKind);
 
     result.type = returnType;
     return result.deref();
   };
+  if (!plan) {
+    proxy.callPath = 'js';
+
+    /**
+     * Invokes the function once for every argument tuple, in order. The
+     * CallPlan's version does this natively; here, it's only for API
+     * compatibility, and the results come back in an Array.
+     */
+
+    proxy.batch = function (calls) {
+      const flat = ArrayBuffer.isView(calls);
+      if (!flat && !Array.isArray(calls)) {
+        throw new TypeError('batch() requires an Array or a TypedArray');
+      }
+      if (flat && (numArgs === 0 || calls.length % numArgs !== 0)) {
+        throw new RangeError('batch(): expected a multiple of ' + numArgs +
+            ' values, got ' + calls.length);
+      }
+      const count = flat ? calls.length / numArgs : calls.length;
+      const results = new Array(count);
+      for (let n = 0; n < count; n++) {
+        const args = flat ? calls.subarray(n * numArgs, (n + 1) * numArgs) : calls[n];
+        if (!flat && (!Array.isArray(args) || args.length !== numArgs)) {
+          throw new TypeError('batch(): call ' + (n + 1) + ' - expected ' +
+              numArgs + ' arguments, got ' + (Array.isArray(args) ? args.length : 0));
+        }
+        try {
+          results[n] = proxy.apply(null, args);
+        } catch (e) {
+          e.message = 'batch(): call ' + (n + 1) + ' - ' + e.message;
+          throw e;
+        }
+      }
+      return returnType.size === 0 ? undefined : results;
+    };
+
+    proxy.map = function () {
+      throw new TypeError('map() requires number or bool argument types');
+    };
+  }
+
+  if (plan) {
+    // the CallPlan has its own `async()`
+    return proxy;
+  }
 
   /**
-   * The asynchronous version of the proxy function.
+   * The asynchronous version of the proxy function. The callback can be
+   * followed by an Object of call options: an AbortSignal as `signal`, and/or
+   * a `timeout` in milliseconds, either of which withdraws the call while it
+   * is still queued. Without a callback, it returns a Promise of the return
+   * value instead, and the options may take the callback's place.
    */
 
   proxy.async = function () {
     debug('invoking async proxy function');
 
     const argc = arguments.length;
-    if (argc !== numArgs + 1) {
+    if (argc < numArgs || argc > numArgs + 2) {
       throw new TypeError('Expected ' + (numArgs + 1) +
           ' arguments, got ' + argc);
     }
 
-    const callback = arguments[argc - 1];
+    const callback = arguments[numArgs];
     if (typeof callback !== 'function') {
-      throw new TypeError('Expected a callback function as argument number: ' +
-          (argc - 1));
+      if (callback !== undefined &&
+          !(argc === numArgs + 1 && typeof callback === 'object')) {
+        throw new TypeError('Expected a callback function as argument number: ' +
+            numArgs);
+      }
+      const args = Array.prototype.slice.call(arguments, 0, numArgs);
+      args.push(undefined, argc === numArgs + 1 ? callback : arguments[numArgs + 1]);
+      return new Promise((resolve, reject) => {
+        args[numArgs] = function (err, value) {
+          if (err) {
+            reject(typeof err === 'string' ? new Error(err) : err);
+          } else {
+            resolve(value);
+          }
+        };
+        proxy.async.apply(null, args);
+      });
     }
+    const callOptions = arguments[numArgs + 1];
 
     // storage buffers for input arguments and the return value
     const result = Buffer.alloc(resultSize);
@@ -102,7 +250,7 @@ function ForeignFunction (cif, funcPtr, returnType, argTypes) {
     }
 
     // invoke the `ffi_call()` function asynchronously
-    bindings.ffi_call_async(cif, funcPtr, result, argsList, function (err) {
+    bindings.ffi_call_async(cif, funcPtr, result, argsList, function (err, errno) {
       // make sure that the 4 Buffers passed in above don't get GC'd while we're
       // doing work on the thread pool...
       [ cif, funcPtr, argsList ].map(() => {});
@@ -112,9 +260,15 @@ function ForeignFunction (cif, funcPtr, returnType, argTypes) {
         callback(err);
       } else {
         result.type = returnType;
-        callback(null, result.deref());
+        const value = result.deref();
+        if (captureErrno) {
+          callback(null, bigint && is64Bit ? BigInt(value) : value, errno);
+        } else {
+          callback(null, bigint && is64Bit ? BigInt(value) : value);
+        }
       }
-    });
+    }, errorFlags, returnKind, name, uvPool, executor, callOptions, timeout,
+    priority, limits);
   }
 
   return proxy;
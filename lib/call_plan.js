@@ -0,0 +1,123 @@
+'use strict';
+/**
+ * Module dependencies.
+ */
+
+const ref = require('ref-napi');
+const debug = require('debug')('ffi:CallPlan');
+const bindings = require('./bindings');
+const KINDS = bindings.VALUE_KINDS;
+
+/**
+ * The "ref" types that values can be converted from/to natively, mapped to
+ * their `ValueKind` (see src/ffi.h).
+ */
+
+const CString = ref.types.CString || ref.types.Utf8String;
+const baseKinds = new Map([
+  [ ref.types.void, KINDS.void ],
+  [ ref.types.int8, KINDS.int8 ],
+  [ ref.types.uint8, KINDS.uint8 ],
+  [ ref.types.int16, KINDS.int16 ],
+  [ ref.types.uint16, KINDS.uint16 ],
+  [ ref.types.int32, KINDS.int32 ],
+  [ ref.types.uint32, KINDS.uint32 ],
+  [ ref.types.int64, KINDS.int64 ],
+  [ ref.types.uint64, KINDS.uint64 ],
+  [ ref.types.float, KINDS.float ],
+  [ ref.types.double, KINDS.double ],
+  [ ref.types.bool, KINDS.bool ],
+  [ CString, KINDS.string ]
+]);
+
+/**
+ * Returns the `ValueKind` for the given (coerced) "ref" type, or `-1` when
+ * values of that type have to go through the type's own `get()`/`set()`.
+ *
+ * Aliases like "int" or "size_t" inherit from one of the base types above,
+ * so the prototype chain is walked. A type that overrides `get()` or `set()`
+ * somewhere along the way is left to JS-land.
+ */
+
+function kindOf (type) {
+  if (type.indirection > 1) {
+    return KINDS.pointer;
+  }
+  if (type.indirection !== 1) {
+    return -1;
+  }
+  let base = type;
+  while (base && !baseKinds.has(base)) {
+    base = Object.getPrototypeOf(base);
+  }
+  if (!base || type.get !== base.get || type.set !== base.set) {
+    return -1;
+  }
+  return baseKinds.get(base);
+}
+
+/**
+ * Returns a native proxy function for the given `ffi_cif *` and function
+ * pointer, which marshals its arguments and return value in C++, or `null`
+ * when any of the types can't be handled natively. With `bigint` set, 64-bit
+ * integers are returned as BigInts. `errorFlags` and `name` configure the
+ * errno capture and error policy (see _foreign_function.js), `uvPool` makes
+ * `async()` calls run on the libuv threadpool, `executor` on the named serial
+ * executor's thread, and `completionHandler` gets their completions delivered
+ * in batches. `timeout` is their default deadline in milliseconds, and
+ * `priority` their default scheduling class. `limits` are the caps that they
+ * count against besides the global ones, if any (see limiter.js).
+ */
+
+function CallPlan (cif, funcPtr, returnType, argTypes, bigint, errorFlags, name, uvPool,
+    completionHandler, executor, timeout, priority, limits) {
+  const kinds = [ kindOf(returnType) ];
+  for (let i = 0; i < argTypes.length; i++) {
+    const kind = kindOf(argTypes[i]);
+    if (kind === KINDS.void) {
+      return null;
+    }
+    kinds.push(kind);
+  }
+  if (kinds.indexOf(-1) !== -1) {
+    debug('not creating a CallPlan, types need JS marshalling');
+    return null;
+  }
+
+  // returned pointers get the same "type" and length as `ref.get()` gives them
+  let rtype;
+  let rsize;
+  if (kinds[0] === KINDS.pointer) {
+    rtype = ref.derefType(returnType);
+    rsize = returnType.indirection === 2 ? returnType.size : ref.sizeof.pointer;
+  }
+
+  // variadic cifs (see cif_var.js) can't use the direct-call thunks
+  const variadic = cif.numFixedArgs !== undefined;
+
+  debug('creating CallPlan', kinds);
+  const proxy = bindings.ffi_call_plan(cif, funcPtr, kinds, rtype, rsize, variadic,
+      cif.callStub, !!bigint, errorFlags | 0, name, !!uvPool, completionHandler,
+      executor, timeout | 0, priority, limits);
+  plans.set(proxy, { kinds: kinds, bigint: !!bigint, pool: executor || (uvPool ? 'uv' : undefined) });
+  return proxy;
+}
+
+// the ValueKinds (return value first) of the CallPlan proxies, for ring.js
+const plans = new WeakMap();
+
+/**
+ * Returns the ValueKinds of a CallPlan proxy function, the return value's
+ * followed by the arguments', whether it returns BigInts, and the `pool` its
+ * async calls run on other than the FFI worker pool: the executor key, or
+ * 'uv'. Returns `undefined` for any other function.
+ */
+
+function describe (fn) {
+  return plans.get(fn);
+}
+
+CallPlan.kindOf = kindOf;
+CallPlan.describe = describe;
+
+module.exports = CallPlan;
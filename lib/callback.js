@@ -7,7 +7,10 @@ const ref = require('ref-napi');
 const CIF = require('./cif');
 const assert = require('assert');
 const debug = require('debug')('ffi:Callback');
-const _Callback = require('./bindings').Callback;
+const bindings = require('./bindings');
+const CallPlan = require('./call_plan');
+const _Callback = bindings.Callback;
+const KINDS = bindings.VALUE_KINDS;
 
 // Function used to report errors to the current process event loop,
 // When user callback function gets gced.
@@ -27,12 +30,24 @@ function errorReportCallback (err) {
  * Turns a JavaScript function into a C function pointer.
  * The function pointer may be used in other C functions that
  * accept C callback functions.
+ *
+ * With `options.nonblocking`, a void callback that gets invoked on another
+ * thread returns to C right away, rather than waiting for the JS function to
+ * have run on the event loop thread. The function gets copies of the
+ * arguments then, including the strings of "string" arguments, but not
+ * whatever other pointers point to. Such invocations don't keep the event
+ * loop alive.
+ *
+ * When all the types are ones that `CallPlan` handles natively, except for
+ * "string" return values, the arguments get decoded and the return value
+ * encoded in C++, and `func` gets called directly.
  */
 
-function Callback (retType, argTypes, abi, func) {
+function Callback (retType, argTypes, abi, func, options) {
   debug('creating new Callback');
 
   if (typeof abi === 'function') {
+    options = func;
     func = abi;
     abi = undefined;
   }
@@ -47,10 +62,32 @@ function Callback (retType, argTypes, abi, func) {
   retType = ref.coerceType(retType);
   argTypes = argTypes.map(ref.coerceType);
 
+  const nonblocking = !!(options && options.nonblocking);
+  assert(!nonblocking || CallPlan.kindOf(retType) === KINDS.void,
+    'nonblocking callbacks must return void');
+  // the strings that nonblocking invocations have to copy
+  const strings = [];
+  if (nonblocking) {
+    argTypes.forEach(function (type, i) {
+      if (CallPlan.kindOf(type) === KINDS.string) {
+        strings.push(i);
+      }
+    });
+  }
+
   // create the `ffi_cif *` instance
   const cif = CIF(retType, argTypes, abi);
   const argc = argTypes.length;
 
+  const native = nativeKinds(retType, argTypes);
+  if (native) {
+    debug('decoding the Callback arguments natively', native.kinds);
+    const callback = _Callback(cif, retType.size, argc, errorReportCallback, func,
+      nonblocking, strings, native.kinds, native.types, native.sizes);
+    callback._cif = cif;
+    return callback;
+  }
+
   const callback = _Callback(cif, retType.size, argc, errorReportCallback, (retval, params) => {
     debug('Callback function being invoked')
     try {
@@ -73,7 +110,7 @@ function Callback (retType, argTypes, abi, func) {
     } catch (e) {
       return e;
     }
-  });
+  }, nonblocking, strings);
   
   // store reference to the CIF Buffer so that it doesn't get
   // garbage collected before the callback Buffer does
@@ -81,4 +118,36 @@ function Callback (retType, argTypes, abi, func) {
   return callback;
 }
 
+/**
+ * Returns the ValueKinds of the return value and the arguments, along with
+ * the "type" and length that pointer arguments get, the same as `ref.get()`
+ * gives them, or `null` when any of the types needs JS marshalling.
+ */
+
+function nativeKinds (retType, argTypes) {
+  const kinds = [ CallPlan.kindOf(retType) ];
+  const types = [];
+  const sizes = [];
+  // the string to return would have to outlive the callback's invocation
+  if (kinds[0] === -1 || kinds[0] === KINDS.string) {
+    return null;
+  }
+  for (let i = 0; i < argTypes.length; i++) {
+    const type = argTypes[i];
+    const kind = CallPlan.kindOf(type);
+    if (kind === -1 || kind === KINDS.void) {
+      return null;
+    }
+    kinds.push(kind);
+    if (kind === KINDS.pointer) {
+      types.push(ref.derefType(type));
+      sizes.push(type.indirection === 2 ? type.size : ref.sizeof.pointer);
+    } else {
+      types.push(undefined);
+      sizes.push(0);
+    }
+  }
+  return { kinds: kinds, types: types, sizes: sizes };
+}
+
 module.exports = Callback;
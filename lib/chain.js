@@ -0,0 +1,79 @@
+'use strict';
+const assert = require('assert');
+const debug = require('debug')('ffi:chain');
+const bindings = require('./bindings');
+
+// see `CallChain::Source` in src/ffi.h
+const SOURCE_CONSTANT = 0;
+const SOURCE_INPUT = 1;
+const SOURCE_RESULT = 2;
+
+/**
+ * Placeholder for an argument that is only known when the chain runs.
+ */
+
+function ChainValue (source, index) {
+  this.source = source;
+  this.index = index;
+}
+
+/**
+ * Creates a function that runs a sequence of foreign calls on a worker thread
+ * as a whole, without coming back to the event loop in between. Each step is
+ * an Array of a ForeignFunction (one whose types are all converted natively)
+ * and its arguments, any of which can be `chain.input(i)`, the i-th argument
+ * the chain gets invoked with, or `chain.result(k)`, the return value of the
+ * k-th step. All the others are constants that are converted once, here.
+ *
+ * The returned function takes the inputs, a callback and optionally the same
+ * call options as `async()`. The callback gets invoked with the return values
+ * of all the steps. When a step's return value is a
+ * failure according to its function's `errorPolicy`, the remaining steps are
+ * skipped, and the callback gets an Error with the `step` that failed and the
+ * `results` so far. Without a callback, the function returns a Promise of
+ * the return values instead.
+ *
+ * The functions of all the steps must run on the same pool or executor, and
+ * have the same `limiter`, if any. The chain runs there, and counts against
+ * those caps as a single call.
+ */
+
+function chain (steps) {
+  assert(Array.isArray(steps), 'expected an Array of steps');
+  debug('creating a chain of %d steps', steps.length);
+
+  const desc = steps.map((step, k) => {
+    assert(Array.isArray(step) && typeof step[0] === 'function',
+      'step ' + k + ' - expected an Array of a ForeignFunction and its arguments');
+    const args = step[1] || [];
+    const sources = [];
+    const indices = [];
+    const values = [];
+    args.forEach((arg) => {
+      if (arg instanceof ChainValue) {
+        sources.push(arg.source);
+        indices.push(arg.index);
+        values.push(undefined);
+      } else {
+        sources.push(SOURCE_CONSTANT);
+        indices.push(0);
+        values.push(arg);
+      }
+    });
+    return [step[0], sources, indices, values];
+  });
+
+  return bindings.ffi_call_chain(desc);
+}
+
+chain.input = function input (index) {
+  assert(Number.isInteger(index) && index >= 0, 'expected an input number');
+  return new ChainValue(SOURCE_INPUT, index);
+};
+
+chain.result = function result (index) {
+  assert(Number.isInteger(index) && index >= 0, 'expected a step number');
+  return new ChainValue(SOURCE_RESULT, index);
+};
+
+module.exports = chain;
@@ -17,6 +17,66 @@ const FFI_OK = bindings.FFI_OK;
 const FFI_BAD_TYPEDEF = bindings.FFI_BAD_TYPEDEF;
 const FFI_BAD_ABI = bindings.FFI_BAD_ABI;
 
+/**
+ * The `ffi_cif *` instances created so far, keyed by their signature (see
+ * `signature()`). A cif never changes after it has been prepared, so all of
+ * the ForeignFunctions and Callbacks with the same signature share one.
+ *
+ * With WeakRefs (Node.js 14.6 and up), a cif that no function or callback
+ * uses anymore gets collected, along with the `ffi_type`s of its struct
+ * types, and its entry goes away then. On older versions, every cif stays
+ * around for good, so creating struct types on the fly keeps using memory.
+ */
+
+const interned = new Map();
+const weak = typeof WeakRef === 'function' && typeof FinalizationRegistry === 'function';
+const registry = weak ? new FinalizationRegistry(function (key) {
+  const entry = interned.get(key);
+  if (entry !== undefined && entry.deref() === undefined) {
+    interned.delete(key);
+  }
+  // the closures kept for reuse by the next Callback of the signature
+  bindings.ffi_sweep_closures();
+}) : null;
+
+function lookup (key) {
+  const entry = interned.get(key);
+  return weak && entry !== undefined ? entry.deref() : entry;
+}
+
+function intern (key, cif) {
+  if (weak) {
+    interned.set(key, new WeakRef(cif));
+    registry.register(cif, key);
+  } else {
+    interned.set(key, cif);
+  }
+}
+const typeIds = new WeakMap();
+let nextTypeId = 0;
+
+function typeId (ffiType) {
+  let id = typeIds.get(ffiType);
+  if (id === undefined) {
+    id = nextTypeId++;
+    typeIds.set(ffiType, id);
+  }
+  return id;
+}
+
+/**
+ * Returns the interning key for a cif with the given ABI, `ffi_type *`
+ * Buffers and number of fixed arguments (`-1` for non-variadic cifs).
+ */
+
+function signature (abi, rtype, argtypes, numFixedArgs) {
+  let key = abi + ':' + numFixedArgs + ':' + typeId(rtype) + ':';
+  for (let i = 0; i < argtypes.length; i++) {
+    key += typeId(argtypes[i]) + ',';
+  }
+  return key;
+}
+
 /**
  * JS wrapper for the `ffi_prep_cif` function.
  * Returns a Buffer instance representing a `ffi_cif *` instance.
@@ -24,35 +84,41 @@ const FFI_BAD_ABI = bindings.FFI_BAD_ABI;
 
 const cifs = [];
 function CIF (rtype, types, abi) {
-  debug('creating `ffi_cif *` instance');
-
   // the return and arg types are expected to be coerced at this point...
   assert(!!rtype, 'expected a return "type" object as the first argument');
   assert(Array.isArray(types), 'expected an Array of arg "type" objects as the second argument');
 
+  if (typeof abi === 'undefined') {
+    debug('no ABI specified (this is OK), using FFI_DEFAULT_ABI');
+    abi = FFI_DEFAULT_ABI;
+  }
+
+  const numArgs = types.length;
+  const _rtypeptr = Type(rtype);
+  const ffiTypes = types.map(Type);
+
+  const key = signature(abi, _rtypeptr, ffiTypes, -1);
+  const existing = lookup(key);
+  if (existing) {
+    debug('reusing `ffi_cif *` instance', key);
+    return existing;
+  }
+
+  debug('creating `ffi_cif *` instance');
+
   // the buffer that will contain the return `ffi_cif *` instance
   const cif = Buffer.alloc(FFI_CIF_SIZE);
 
-  const numArgs = types.length;
   const _argtypesptr = Buffer.alloc(numArgs * POINTER_SIZE);
-  const _rtypeptr = Type(rtype);
 
   for (var i = 0; i < numArgs; i++) {
-    const type = types[i];
-    const ffiType = Type(type);
-
-    _argtypesptr.writePointer(ffiType, i * POINTER_SIZE);
+    _argtypesptr.writePointer(ffiTypes[i], i * POINTER_SIZE);
   }
 
   // prevent GC of the arg type and rtn type buffers (not sure if this is required)
   cif.rtnTypePtr = _rtypeptr;
   cif.argTypesPtr = _argtypesptr;
 
-  if (typeof abi === 'undefined') {
-    debug('no ABI specified (this is OK), using FFI_DEFAULT_ABI');
-    abi = FFI_DEFAULT_ABI;
-  }
-
   const status = ffi_prep_cif(cif, numArgs, _rtypeptr, _argtypesptr, abi);
 
   if (status !== FFI_OK) {
@@ -78,7 +144,12 @@ function CIF (rtype, types, abi) {
 
   if (debug.enabled || `${process.env.DEBUG}`.match(/\bffi\b/))
     cifs.push(cif);
+  intern(key, cif);
   return cif;
 }
 
+CIF.signature = signature;
+CIF.lookup = lookup;
+CIF.intern = intern;
+
 module.exports = CIF;
@@ -4,6 +4,7 @@
  */
 
 const Type = require('./type');
+const CIF = require('./cif');
 const assert = require('assert');
 const debug = require('debug')('ffi:cif_var');
 const ref = require('ref-napi');
@@ -23,33 +24,43 @@ const FFI_BAD_ABI = bindings.FFI_BAD_ABI;
  */
 
 function CIF_var (rtype, types, numFixedArgs, abi) {
-  debug('creating `ffi_cif *` instance with `ffi_prep_cif_var()`');
-
   // the return and arg types are expected to be coerced at this point...
   assert(!!rtype, 'expected a return "type" object as the first argument');
   assert(Array.isArray(types), 'expected an Array of arg "type" objects as the second argument');
   assert(numFixedArgs >= 1, 'expected the number of fixed arguments to be at least 1');
 
+  if (typeof abi === 'undefined') {
+    debug('no ABI specified (this is OK), using FFI_DEFAULT_ABI');
+    abi = FFI_DEFAULT_ABI;
+  }
+
+  const numTotalArgs = types.length;
+  const _rtypeptr = Type(rtype);
+  const ffiTypes = types.map(Type);
+
+  // shares the interned cifs with `CIF()`
+  const key = CIF.signature(abi, _rtypeptr, ffiTypes, numFixedArgs);
+  const existing = CIF.lookup(key);
+  if (existing) {
+    debug('reusing `ffi_cif *` instance', key);
+    return existing;
+  }
+
+  debug('creating `ffi_cif *` instance with `ffi_prep_cif_var()`');
+
   // the buffer that will contain the return `ffi_cif *` instance
   const cif = Buffer.alloc(FFI_CIF_SIZE);
 
-  const numTotalArgs = types.length;
   const _argtypesptr = Buffer.alloc(numTotalArgs * POINTER_SIZE);
-  const _rtypeptr = Type(rtype);
 
   for (let i = 0; i < numTotalArgs; i++) {
-    const ffiType = Type(types[i]);
-    _argtypesptr.writePointer(ffiType, i * POINTER_SIZE);
+    _argtypesptr.writePointer(ffiTypes[i], i * POINTER_SIZE);
   }
 
   // prevent GC of the arg type and rtn type buffers (not sure if this is required)
   cif.rtnTypePtr = _rtypeptr;
   cif.argTypesPtr = _argtypesptr;
-
-  if (typeof abi === 'undefined') {
-    debug('no ABI specified (this is OK), using FFI_DEFAULT_ABI');
-    abi = FFI_DEFAULT_ABI;
-  }
+  cif.numFixedArgs = numFixedArgs;
 
   const status = ffi_prep_cif_var(cif, numFixedArgs, numTotalArgs, _rtypeptr, _argtypesptr, abi);
 
@@ -78,6 +89,7 @@ function CIF_var (rtype, types, numFixedArgs, abi) {
     }
   }
 
+  CIF.intern(key, cif);
   return cif;
 }
 
@@ -83,6 +83,12 @@ exports.DynamicLibrary = require('./dynamic_library');
 exports.Library = require('./library');
 exports.Callback = require('./callback');
 exports.errno = require('./errno');
+exports.lastErrno = bindings.ffi_last_errno;
+exports.configurePool = require('./worker_pool');
+exports.Limiter = require('./limiter');
+exports.limits = exports.Limiter.global;
+exports.chain = require('./chain');
+exports.Ring = require('./ring');
 exports.ffiType = require('./type');
 
 // the shared library extension for this platform
@@ -14,9 +14,22 @@ const ref = require('ref-napi');
  * of function execution, including marshalling the data parameters for the
  * function into native types and also unmarshalling the return from function
  * execution.
+ *
+ * `options.bigint` makes the function return 64-bit integers as BigInts.
+ * `options.errno` captures `errno` right after every call (see
+ * `ffi.lastErrno()`), and `options.errorPolicy` ("negative", "nonzero" or
+ * "zero") makes it throw an Error carrying `errno` when the return value
+ * signals a failure. `options.pool` ("ffi" or "uv") selects the thread pool
+ * that `async()` calls run on. Alternatively, `options.executor` names a
+ * dedicated thread that runs the async calls of all the functions with the
+ * same executor one after the other, in order. `options.timeout` drops async
+ * calls that haven't started that many milliseconds after they were made, and
+ * `options.priority` ("interactive", "normal" or "bulk") is their scheduling
+ * class on the FFI worker pool. `options.limiter` puts caps on the async calls
+ * in flight (see Limiter).
  */
 
-function ForeignFunction (funcPtr, returnType, argTypes, abi) {
+function ForeignFunction (funcPtr, returnType, argTypes, abi, options) {
   debug('creating new ForeignFunction', funcPtr);
 
   // check args
@@ -33,7 +46,7 @@ function ForeignFunction (funcPtr, returnType, argTypes, abi) {
   const cif = CIF(returnType, argTypes, abi);
 
   // create and return the JS proxy function
-  return _ForeignFunction(cif, funcPtr, returnType, argTypes);
+  return _ForeignFunction(cif, funcPtr, returnType, argTypes, options);
 }
 
 module.exports = ForeignFunction;
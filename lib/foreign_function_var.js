@@ -21,7 +21,7 @@ const FFI_ARG_SIZE = bindings.FFI_ARG_SIZE;
  * contain the same ffi_type argument signature.
  */
 
-function VariadicForeignFunction (funcPtr, returnType, fixedArgTypes, abi) {
+function VariadicForeignFunction (funcPtr, returnType, fixedArgTypes, abi, options) {
   debug('creating new VariadicForeignFunction', funcPtr);
 
   // the cache of ForeignFunction instances that this
@@ -78,7 +78,7 @@ function VariadicForeignFunction (funcPtr, returnType, fixedArgTypes, abi) {
       // create the `ffi_cif *` instance
       debug('creating the variadic ffi_cif instance for key:', key);
       const cif = CIF_var(returnType, argTypes, numFixedArgs, abi);
-      func = cache[key] = _ForeignFunction(cif, funcPtr, rtnType, argTypes);
+      func = cache[key] = _ForeignFunction(cif, funcPtr, rtnType, argTypes, options);
     }
     return func;
   }
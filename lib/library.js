@@ -29,9 +29,14 @@ const EXT = Library.EXT = {
 /**
  * Provides a friendly abstraction/API on-top of DynamicLibrary and
  * ForeignFunction.
+ *
+ * With `options.lazy` set, the functions are only looked up and prepared
+ * when their property is first read (and a missing symbol only throws then).
+ * `options.executor` sets the default executor of the functions' async calls
+ * (see ForeignFunction), and `options.limiter` the default caps on them.
  */
 
-function Library (libfile, funcs, lib) {
+function Library (libfile, funcs, lib, options) {
   debug('creating Library object for', libfile);
 
   if (libfile && typeof libfile === 'string' && libfile.indexOf(EXT) === -1) {
@@ -49,7 +54,11 @@ function Library (libfile, funcs, lib) {
     dl = libfile;
   }
 
-  Object.keys(funcs || {}).forEach(function (func) {
+  const lazy = !!(options && options.lazy);
+  const executor = options && options.executor;
+  const limiter = options && options.limiter;
+
+  function bind (func) {
     debug('defining function', func);
 
     const fptr = dl.get(func);
@@ -66,13 +75,45 @@ function Library (libfile, funcs, lib) {
     const abi = fopts && fopts.abi;
     const async = fopts && fopts.async;
     const varargs = fopts && fopts.varargs;
+    // the name shows up in the Errors thrown by the "errorPolicy" option
+    const ffOptions = Object.assign({ name: func, executor: executor, limiter: limiter }, fopts);
 
     if (varargs) {
-      lib[func] = VariadicForeignFunction(fptr, resultType, paramTypes, abi);
-    } else {
-      const ff = ForeignFunction(fptr, resultType, paramTypes, abi);
-      lib[func] = async ? ff.async : ff;
+      return VariadicForeignFunction(fptr, resultType, paramTypes, abi, ffOptions);
     }
+    const ff = ForeignFunction(fptr, resultType, paramTypes, abi, ffOptions);
+    return async ? ff.async : ff;
+  }
+
+  Object.keys(funcs || {}).forEach(function (func) {
+    if (!lazy) {
+      lib[func] = bind(func);
+      return;
+    }
+
+    // replaced by the actual function on first access
+    Object.defineProperty(lib, func, {
+      configurable: true,
+      enumerable: true,
+      get: function () {
+        const value = bind(func);
+        Object.defineProperty(lib, func, {
+          configurable: true,
+          enumerable: true,
+          writable: true,
+          value: value
+        });
+        return value;
+      },
+      set: function (value) {
+        Object.defineProperty(lib, func, {
+          configurable: true,
+          enumerable: true,
+          writable: true,
+          value: value
+        });
+      }
+    });
   });
 
   return lib;
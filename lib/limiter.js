@@ -0,0 +1,82 @@
+'use strict';
+const assert = require('assert');
+const debug = require('debug')('ffi:Limiter');
+const bindings = require('./bindings');
+
+/**
+ * Caps on the asynchronous calls of the functions it's given to with the
+ * `limiter` option (of ForeignFunction or Library), along with live gauges
+ * of those calls. All the async calls also count against the global caps of
+ * `ffi.limits`, which has none by default. Calls of a `Ring` don't count, as
+ * a ring has a fixed capacity of its own.
+ *
+ * `options.maxInFlight` caps the calls that have been made and whose callback
+ * hasn't been called yet, and `options.maxQueued` those that no thread has
+ * picked up yet (0 or undefined for no cap). A call over a cap is refused
+ * right away: `async()` throws an Error with the "ERR_FFI_QUEUE_FULL" code,
+ * or returns a Promise rejected with it. With `onFull: 'backpressure'`, such
+ * calls go ahead nevertheless, but `full` becomes true, and
+ * `options.onDrain()` gets called once there's room again.
+ */
+
+function Limiter (options) {
+  if (!(this instanceof Limiter)) {
+    return new Limiter(options);
+  }
+  this._limits = bindings.ffi_async_limits(false);
+  this.configure(options);
+}
+
+/**
+ * Replaces the caps and their options, see above.
+ */
+
+Limiter.prototype.configure = function (options) {
+  options = options || {};
+  const maxInFlight = options.maxInFlight || 0;
+  const maxQueued = options.maxQueued || 0;
+  const onFull = options.onFull || 'reject';
+  assert(Number.isInteger(maxInFlight) && maxInFlight >= 0,
+    'expected a non-negative integer as "maxInFlight"');
+  assert(Number.isInteger(maxQueued) && maxQueued >= 0,
+    'expected a non-negative integer as "maxQueued"');
+  assert(onFull === 'reject' || onFull === 'backpressure',
+    'onFull must be "reject" or "backpressure"');
+  assert(!options.onDrain || typeof options.onDrain === 'function',
+    'onDrain must be a function');
+
+  debug('configuring async limits', options);
+  bindings.ffi_configure_async_limits(this._limits, maxInFlight, maxQueued,
+    onFull === 'backpressure', options.onDrain);
+};
+
+/**
+ * Whether calls are over the caps, with `onFull: 'backpressure'`.
+ */
+
+Object.defineProperty(Limiter.prototype, 'full', {
+  get: function () {
+    return bindings.ffi_async_limits_full(this._limits);
+  }
+});
+
+/**
+ * Returns the gauges: the calls `inFlight`, `queued` and `running`, the
+ * totals of `completed` and `refused` calls, whether the caps are `full`, and
+ * the `p50` and `p99` percentiles of the calls' `queueWait` (until a thread
+ * picked them up) and `runTime`, in milliseconds. With `reset`, the totals
+ * and percentiles start over afterwards.
+ */
+
+Limiter.prototype.stats = function (reset) {
+  return bindings.ffi_async_stats(this._limits, !!reset);
+};
+
+/**
+ * The global caps, which apply to all the async calls.
+ */
+
+Limiter.global = Object.create(Limiter.prototype);
+Limiter.global._limits = bindings.ffi_async_limits(true);
+
+module.exports = Limiter;
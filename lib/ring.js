@@ -0,0 +1,224 @@
+'use strict';
+const assert = require('assert');
+const os = require('os');
+const ref = require('ref-napi');
+const debug = require('debug')('ffi:Ring');
+const bindings = require('./bindings');
+const CallPlan = require('./call_plan');
+const KINDS = bindings.VALUE_KINDS;
+const LE = os.endianness() === 'LE';
+
+// the ring layout, see `CallRing` in src/ffi.h: the head and tail indices
+// (as Uint32Array indices here), then the entries
+const HEAD = 0;
+const TAIL = 16;
+const ENTRIES_OFFSET = 128;
+const COMPLETION_SIZE = 24;
+
+/**
+ * A submission ring and a completion ring in SharedArrayBuffers, for making
+ * large numbers of asynchronous calls of a fixed set of functions (ones whose
+ * types are all converted natively, strings excepted) with very little
+ * overhead per call.
+ *
+ * `submit()` writes a call straight into the submission ring, and `flush()`
+ * has an FFI worker run all the calls submitted so far. The results go into
+ * the completion ring, where `poll()` picks them up. With the `onCompletion`
+ * option, `poll(onCompletion)` is invoked whenever a worker is done with a
+ * batch of calls. Neither side allocates anything per call.
+ *
+ * Arguments are written as they are, without any range checks. Pointers are
+ * passed and returned as addresses, so whatever they point to has to be kept
+ * alive by other means until the call is done.
+ *
+ * `options.entries` is the capacity of each ring, a power of 2 (1024 by
+ * default), and `options.priority` that of the calls on the worker pool. The
+ * calls always run on the FFI worker pool, so functions with an `executor`
+ * or the `pool: 'uv'` option can't go in a ring.
+ */
+
+function Ring (functions, options) {
+  if (!(this instanceof Ring)) {
+    return new Ring(functions, options);
+  }
+  options = options || {};
+  const entries = options.entries || 1024;
+  assert(Array.isArray(functions) && functions.length > 0,
+    'expected an Array of ForeignFunctions');
+  assert(Number.isInteger(entries) && entries > 0 && entries <= 0x10000 &&
+    (entries & (entries - 1)) === 0, 'entries must be a power of 2, up to 65536');
+  const onCompletion = options.onCompletion;
+  assert(!onCompletion || typeof onCompletion === 'function',
+    'onCompletion must be a function');
+
+  this.functions = functions.map((fn, i) => {
+    const desc = CallPlan.describe(fn);
+    assert(desc, 'function ' + i + ' - expected a ForeignFunction whose ' +
+      'types are all converted natively');
+    if (desc.pool !== undefined) {
+      throw new TypeError('function ' + i + ' - functions of an executor or ' +
+        'the libuv threadpool can\'t be called through a ring');
+    }
+    return desc;
+  });
+  const maxArgs = Math.max.apply(null,
+    this.functions.map((desc) => desc.kinds.length - 1));
+
+  this.entries = entries;
+  this.entrySize = 8 + 8 * maxArgs;
+  this.sq = new SharedArrayBuffer(ENTRIES_OFFSET + entries * this.entrySize);
+  this.cq = new SharedArrayBuffer(ENTRIES_OFFSET + entries * COMPLETION_SIZE);
+  this._sqIndices = new Uint32Array(this.sq, 0, ENTRIES_OFFSET / 4);
+  this._cqIndices = new Uint32Array(this.cq, 0, ENTRIES_OFFSET / 4);
+  this._sqView = new DataView(this.sq);
+  this._cqView = new DataView(this.cq);
+  // only ever written by this side
+  this._sqTail = 0;
+  this._cqHead = 0;
+
+  debug('creating a ring of %d entries for %d functions', entries, functions.length);
+  this._notify = bindings.ffi_call_ring(new Uint8Array(this.sq),
+    new Uint8Array(this.cq), functions, entries,
+    onCompletion ? () => this.poll(onCompletion) : undefined, options.priority);
+}
+
+/**
+ * Submits a call of the function with the given index, followed by a uint32
+ * tag that comes back with its completion, and the function's arguments.
+ * Returns false, without submitting anything, when the ring is full.
+ */
+
+Ring.prototype.submit = function (index, tag) {
+  const desc = this.functions[index];
+  if (desc === undefined) {
+    throw new RangeError('there is no function ' + index + ' in the ring');
+  }
+  const kinds = desc.kinds;
+  if (arguments.length !== kinds.length + 1) {
+    throw new TypeError('Expected ' + (kinds.length + 1) + ' arguments, got ' +
+        arguments.length);
+  }
+
+  const tail = this._sqTail;
+  if (((tail - Atomics.load(this._sqIndices, HEAD)) >>> 0) >= this.entries) {
+    return false;
+  }
+  const view = this._sqView;
+  const offset = ENTRIES_OFFSET + (tail & (this.entries - 1)) * this.entrySize;
+  view.setUint32(offset, index, LE);
+  view.setUint32(offset + 4, tag >>> 0, LE);
+  for (let n = 1; n < kinds.length; n++) {
+    writeValue(view, offset + n * 8, kinds[n], arguments[n + 1]);
+  }
+
+  this._sqTail = (tail + 1) >>> 0;
+  Atomics.store(this._sqIndices, TAIL, this._sqTail);
+  return true;
+};
+
+/**
+ * Has an FFI worker run all the calls submitted so far. One notification
+ * covers any number of calls.
+ */
+
+Ring.prototype.flush = function () {
+  this._notify();
+};
+
+/**
+ * Invokes `callback(tag, err, result)` for every completion there is, in
+ * order, and returns their number. `err` is 0, or the captured `errno` (-1
+ * when there is none) of a call whose result failed its function's
+ * `errorPolicy`.
+ */
+
+Ring.prototype.poll = function (callback) {
+  const view = this._cqView;
+  const tail = Atomics.load(this._cqIndices, TAIL);
+  let count = 0;
+  while (this._cqHead !== tail) {
+    const offset = ENTRIES_OFFSET +
+      (this._cqHead & (this.entries - 1)) * COMPLETION_SIZE;
+    const tag = view.getUint32(offset, LE);
+    const desc = this.functions[view.getUint32(offset + 4, LE)];
+    const err = view.getInt32(offset + 8, LE);
+    const result = desc === undefined ? undefined
+      : readValue(view, offset + 16, desc.kinds[0], desc.bigint);
+
+    // free the entry before the callback gets a chance to throw
+    this._cqHead = (this._cqHead + 1) >>> 0;
+    Atomics.store(this._cqIndices, HEAD, this._cqHead);
+    count++;
+    callback(tag, err, result);
+  }
+
+  // the worker stops when the completion ring is full
+  if (count > 0 && this.pending() > 0) {
+    this._notify();
+  }
+  return count;
+};
+
+/**
+ * The number of submitted calls that no worker has picked up yet.
+ */
+
+Ring.prototype.pending = function () {
+  return (this._sqTail - Atomics.load(this._sqIndices, HEAD)) >>> 0;
+};
+
+function writeValue (view, offset, kind, val) {
+  switch (kind) {
+    case KINDS.int8: view.setInt8(offset, val); break;
+    case KINDS.uint8: view.setUint8(offset, val); break;
+    case KINDS.int16: view.setInt16(offset, val, LE); break;
+    case KINDS.uint16: view.setUint16(offset, val, LE); break;
+    case KINDS.int32: view.setInt32(offset, val, LE); break;
+    case KINDS.uint32: view.setUint32(offset, val, LE); break;
+    case KINDS.int64: view.setBigInt64(offset, BigInt(val), LE); break;
+    case KINDS.uint64: view.setBigUint64(offset, BigInt(val), LE); break;
+    case KINDS.float: view.setFloat32(offset, val, LE); break;
+    case KINDS.double: view.setFloat64(offset, val, LE); break;
+    case KINDS.bool: view.setUint8(offset, val ? 1 : 0); break;
+    case KINDS.pointer: {
+      const address = Buffer.isBuffer(val) ? ref.address(val) : val || 0;
+      if (ref.sizeof.pointer === 8) {
+        view.setBigUint64(offset, BigInt(address), LE);
+      } else {
+        view.setUint32(offset, Number(address), LE);
+      }
+      break;
+    }
+  }
+}
+
+function readValue (view, offset, kind, bigint) {
+  switch (kind) {
+    case KINDS.void: return undefined;
+    case KINDS.int8: return view.getInt8(offset);
+    case KINDS.uint8: return view.getUint8(offset);
+    case KINDS.int16: return view.getInt16(offset, LE);
+    case KINDS.uint16: return view.getUint16(offset, LE);
+    case KINDS.int32: return view.getInt32(offset, LE);
+    case KINDS.uint32: return view.getUint32(offset, LE);
+    case KINDS.int64: return from64(view.getBigInt64(offset, LE), bigint);
+    case KINDS.uint64: return from64(view.getBigUint64(offset, LE), bigint);
+    case KINDS.float: return view.getFloat32(offset, LE);
+    case KINDS.double: return view.getFloat64(offset, LE);
+    case KINDS.bool: return view.getUint8(offset) !== 0;
+    case KINDS.pointer:
+      return ref.sizeof.pointer === 8
+        ? Number(view.getBigUint64(offset, LE)) : view.getUint32(offset, LE);
+  }
+}
+
+// like the CallPlan's results: Numbers when safe, Strings otherwise
+function from64 (value, bigint) {
+  if (bigint) {
+    return value;
+  }
+  const number = Number(value);
+  return Number.isSafeInteger(number) ? number : value.toString();
+}
+
+module.exports = Ring;
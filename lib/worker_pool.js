@@ -0,0 +1,37 @@
+'use strict';
+const assert = require('assert');
+const debug = require('debug')('ffi:WorkerPool');
+const bindings = require('./bindings');
+
+/**
+ * Configures the dedicated worker pool that asynchronous calls run on (unless
+ * their function was created with the `pool: 'uv'` option), and the serial
+ * executors. The pool gets started by the first such call, and an executor by
+ * the first call with its key, after which neither can be reconfigured
+ * anymore.
+ *
+ * `options.size` is the number of threads (4 by default), `options.name` the
+ * prefix of their names ("ffi-worker") and `options.stackSize` their stack
+ * size in bytes (the platform's default when 0).
+ *
+ * With `options.coalesce`, all the async calls that have completed by the time
+ * the event loop gets to them have their callbacks invoked in one go, with
+ * the microtask queue (Promise reactions, ...) processed once afterwards
+ * rather than after every single callback.
+ */
+
+function configurePool (options) {
+  options = options || {};
+  assert(options.size === undefined || (Number.isInteger(options.size) && options.size > 0),
+    'expected a positive integer as the pool "size"');
+  assert(options.name === undefined || typeof options.name === 'string',
+    'expected a String as the pool "name"');
+  assert(options.stackSize === undefined || (Number.isInteger(options.stackSize) && options.stackSize >= 0),
+    'expected a non-negative integer as the pool "stackSize"');
+
+  debug('configuring the worker pool', options);
+  bindings.ffi_configure_pool(options.size, options.name, options.stackSize,
+    options.coalesce === undefined ? undefined : !!options.coalesce);
+}
+
+module.exports = configurePool;
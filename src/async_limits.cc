@@ -0,0 +1,269 @@
+#include <math.h>
+#include "ffi.h"
+
+namespace FFI {
+
+/*
+ * The bucket of a duration in microseconds: the values below 4 get one each,
+ * every power of 2 above that gets 4.
+ */
+
+static size_t DurationBucket(uint64_t us) {
+  if (us < 4)
+    return static_cast<size_t>(us);
+  size_t msb = 0;
+  for (uint64_t v = us; v > 1; v >>= 1)
+    msb++;
+  return 4 * (msb - 1) + ((us >> (msb - 2)) & 3);
+}
+
+// the middle of a bucket, in microseconds
+static double BucketValue(size_t bucket) {
+  if (bucket < 4)
+    return bucket + 0.5;
+  double width = static_cast<double>(UINT64_C(1) << (bucket / 4 - 1));
+  return (4 + bucket % 4) * width + width / 2;
+}
+
+void DurationHistogram::Record(uint64_t nanoseconds) {
+  size_t bucket = DurationBucket(nanoseconds / 1000);
+  if (bucket >= kNumBuckets)
+    bucket = kNumBuckets - 1;
+  buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+}
+
+double DurationHistogram::Percentile(double p) const {
+  uint64_t counts[kNumBuckets];
+  uint64_t total = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    counts[i] = buckets[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0)
+    return 0;
+
+  uint64_t rank = static_cast<uint64_t>(ceil(p * total));
+  if (rank == 0)
+    rank = 1;
+  uint64_t seen = 0;
+  for (size_t i = 0; i < kNumBuckets; i++) {
+    seen += counts[i];
+    if (seen >= rank)
+      return BucketValue(i) / 1000;
+  }
+  return BucketValue(kNumBuckets - 1) / 1000;
+}
+
+void DurationHistogram::Reset() {
+  for (std::atomic<uint64_t>& bucket : buckets)
+    bucket.store(0, std::memory_order_relaxed);
+}
+
+/*
+ * The caps of async calls.
+ *
+ * Every async call counts against the global caps, and against those of its
+ * function, if it has any (the `limiter` option). A call over a cap is
+ * refused before anything gets allocated for it: `async()` throws an Error
+ * with the "ERR_FFI_QUEUE_FULL" code, or returns a promise rejected with it.
+ * With `backpressure`, calls over the caps are accepted nevertheless, but the
+ * caps are marked `full`, and `on_drain` gets invoked once they no longer
+ * are, like a stream's "drain" event.
+ *
+ * The queue wait (from the call until a worker picks it up) and the run time
+ * of every call are recorded in histograms, from the worker threads.
+ */
+
+bool AsyncLimits::AtCap() const {
+  return (max_in_flight != 0 && in_flight >= max_in_flight) ||
+         (max_queued != 0 && queued.load() >= max_queued);
+}
+
+bool AsyncLimits::Admit() {
+  if (backpressure || !AtCap())
+    return true;
+  refused++;
+  return false;
+}
+
+// whether a call may go ahead, as far as the global caps and `own` go
+bool AsyncLimits::AdmitCall(InstanceData* instance, AsyncLimits* own) {
+  return instance->Limits()->Admit() && (own == nullptr || own->Admit());
+}
+
+void AsyncLimits::Submitted() {
+  in_flight++;
+  queued++;
+  refs++;
+  if (backpressure && AtCap())
+    full = true;
+}
+
+/*
+ * Called on the thread pool when a worker picks up the call, whether it gets
+ * to `running` it or has been withdrawn in the meantime.
+ */
+
+void AsyncLimits::Started(uint64_t wait, bool running_) {
+  queued--;
+  if (running_)
+    running++;
+  queue_wait.Record(wait);
+}
+
+void AsyncLimits::Stopped(uint64_t run) {
+  running--;
+  run_time.Record(run);
+}
+
+/*
+ * Called on the loop thread once the call is done with, right before its
+ * callback gets called. Lets JS-land know when there's room again, and drops
+ * the call's reference.
+ */
+
+void AsyncLimits::Completed(Env env, bool started) {
+  if (!started)
+    queued--;
+  in_flight--;
+  completed++;
+
+  if (full && !AtCap()) {
+    full = false;
+    if (!on_drain.IsEmpty()) {
+      try {
+        on_drain.Value().MakeCallback(env.Global(), {});
+      } catch (const Error& e) {
+        napi_fatal_exception(env, e.Value());
+      }
+    }
+  }
+  Release(this);
+}
+
+void AsyncLimits::Release(AsyncLimits* limits) {
+  if (--limits->refs == 0)
+    delete limits;
+}
+
+AsyncLimits* AsyncLimits::From(Value value) {
+  return value.IsExternal() ? value.As<External<AsyncLimits>>().Data()
+                            : nullptr;
+}
+
+/*
+ * The outcome of a call that got refused: throws the Error, or returns a
+ * promise rejected with it for a call that would have returned one.
+ */
+
+Value AsyncLimits::Refuse(Env env, bool promise) {
+  Error e = Error::New(env, "Too many async calls in flight");
+  e.Set("code", String::New(env, "ERR_FFI_QUEUE_FULL"));
+  if (!promise)
+    throw e;
+
+  napi_deferred deferred;
+  napi_value result;
+  if (napi_create_promise(env, &deferred, &result) != napi_ok)
+    throw Error::New(env);
+  napi_reject_deferred(env, deferred, e.Value());
+  return Value(env, result);
+}
+
+/*
+ * args[0] - Boolean - the global caps, instead of a new set of caps
+ *
+ * returns an External of the caps, for `ffi_configure_async_limits()` and
+ * `ffi_call_plan()`
+ */
+
+Value AsyncLimits::New(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  AsyncLimits* limits = args[0].ToBoolean() ? InstanceData::Get(env)->Limits()
+                                            : new AsyncLimits();
+  limits->refs++;
+  return External<AsyncLimits>::New(env, limits, [](Env, AsyncLimits* data) {
+    Release(data);
+  });
+}
+
+/*
+ * args[0] - External - the caps
+ * args[1] - Number - the cap on the calls in flight, 0 for none
+ * args[2] - Number - the cap on the queued calls, 0 for none
+ * args[3] - Boolean - signal backpressure instead of refusing calls
+ * args[4] - Function - invoked when the caps are no longer full, if any
+ */
+
+Value AsyncLimits::Configure(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  AsyncLimits* limits = From(args[0]);
+  if (limits == nullptr)
+    throw TypeError::New(env, "ffi_configure_async_limits() requires caps");
+
+  limits->max_in_flight = args[1].ToNumber().Uint32Value();
+  limits->max_queued = args[2].ToNumber().Uint32Value();
+  limits->backpressure = args[3].ToBoolean();
+  if (args[4].IsFunction())
+    limits->on_drain = Persistent(args[4].As<Function>());
+  else
+    limits->on_drain.Reset();
+  limits->full = limits->backpressure && limits->AtCap();
+  return env.Undefined();
+}
+
+Value AsyncLimits::Full(const Napi::CallbackInfo& args) {
+  AsyncLimits* limits = From(args[0]);
+  return Boolean::New(args.Env(), limits != nullptr && limits->full);
+}
+
+/*
+ * args[0] - External - the caps
+ * args[1] - Boolean - start over with the totals and the histograms
+ */
+
+Value AsyncLimits::Stats(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  AsyncLimits* limits = From(args[0]);
+  if (limits == nullptr)
+    throw TypeError::New(env, "ffi_async_stats() requires caps");
+
+  Object stats = Object::New(env);
+  stats["inFlight"] = Number::New(env, limits->in_flight);
+  stats["queued"] = Number::New(env, limits->queued.load());
+  stats["running"] = Number::New(env, limits->running.load());
+  stats["completed"] = Number::New(env, static_cast<double>(limits->completed));
+  stats["refused"] = Number::New(env, static_cast<double>(limits->refused));
+  stats["full"] = Boolean::New(env, limits->full);
+
+  const DurationHistogram* histograms[] = {
+    &limits->queue_wait, &limits->run_time
+  };
+  const char* names[] = { "queueWait", "runTime" };
+  for (size_t i = 0; i < 2; i++) {
+    Object percentiles = Object::New(env);
+    percentiles["p50"] = Number::New(env, histograms[i]->Percentile(0.5));
+    percentiles["p99"] = Number::New(env, histograms[i]->Percentile(0.99));
+    stats[names[i]] = percentiles;
+  }
+
+  if (args[1].ToBoolean()) {
+    limits->completed = 0;
+    limits->refused = 0;
+    limits->queue_wait.Reset();
+    limits->run_time.Reset();
+  }
+  return stats;
+}
+
+// lives as long as the environment, as calls still running when it's torn
+// down can outlive the InstanceData
+AsyncLimits* InstanceData::Limits() {
+  if (limits == nullptr) {
+    limits = new AsyncLimits();
+    limits->refs++;
+  }
+  return limits;
+}
+
+}  // namespace FFI
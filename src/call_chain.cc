@@ -0,0 +1,400 @@
+#include <algorithm>
+#include "ffi.h"
+
+namespace FFI {
+
+namespace {
+
+/*
+ * Whether a result of kind `from` can be passed on as an argument of kind
+ * `to`. Both are the same size then, so the value can be used as it is.
+ */
+
+bool Compatible(ValueKind from, ValueKind to) {
+  if (from == to)
+    return true;
+  return (from == ValueKind::kPointer || from == ValueKind::kCString) &&
+         (to == ValueKind::kPointer || to == ValueKind::kCString);
+}
+
+std::string StepPrefix(size_t k) {
+  return "chain(): step " + std::to_string(k) + " - ";
+}
+
+}  // anonymous namespace
+
+/*
+ * Creates the JS function that runs a chain.
+ *
+ * args[0] - Array - the steps, each an Array of:
+ *           [0] Function - the CallPlan proxy of a ForeignFunction
+ *           [1] Array - the CallChain::Source of every argument
+ *           [2] Array - the input or step number of every argument
+ *           [3] Array - the values of the constant arguments
+ *
+ * returns a Function that takes the chain's inputs and a callback
+ */
+
+Value CallChain::New(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  if (!args[0].IsArray())
+    throw TypeError::New(env, "ffi_call_chain() requires an Array of steps");
+  Array steps = args[0].As<Array>();
+
+  std::unique_ptr<CallChain> chain(new CallChain());
+  chain->instance = InstanceData::Get(env);
+
+  // the constants are pointed to directly, so their storage can't move
+  size_t num_constants = 0;
+  for (uint32_t k = 0; k < steps.Length(); k++) {
+    Array sources = steps.Get(k).As<Array>().Get(1u).As<Array>();
+    for (uint32_t j = 0; j < sources.Length(); j++) {
+      if (sources.Get(j).ToNumber().Uint32Value() ==
+          static_cast<uint32_t>(Source::kConstant))
+        num_constants++;
+    }
+  }
+  chain->constants.reserve(num_constants);
+  chain->constant_strings.reserve(num_constants);
+
+  try {
+    for (uint32_t k = 0; k < steps.Length(); k++) {
+      Array desc = steps.Get(k).As<Array>();
+      void* data = nullptr;
+      if (!desc.Get(0u).IsFunction() ||
+          napi_unwrap(env, desc.Get(0u), &data) != napi_ok) {
+        throw TypeError::New(env, StepPrefix(k) + "expected a ForeignFunction "
+            "whose types are all converted natively");
+      }
+
+      Step step;
+      step.plan = static_cast<CallPlan*>(data);
+      step.avalue_offset = chain->num_args;
+      const std::vector<ValueKind>& kinds = step.plan->kinds;
+      chain->num_args += kinds.size();
+
+      Array sources = desc.Get(1u).As<Array>();
+      Array indices = desc.Get(2u).As<Array>();
+      Array values = desc.Get(3u).As<Array>();
+      if (sources.Length() != kinds.size()) {
+        throw TypeError::New(env, StepPrefix(k) + "expected " +
+            std::to_string(kinds.size()) + " arguments, got " +
+            std::to_string(sources.Length()));
+      }
+
+      for (uint32_t j = 0; j < kinds.size(); j++) {
+        Source source =
+            static_cast<Source>(sources.Get(j).ToNumber().Uint32Value());
+        uint32_t index = indices.Get(j).ToNumber().Uint32Value();
+        ValueKind kind = kinds[j];
+
+        switch (source) {
+          case Source::kConstant:
+            index = static_cast<uint32_t>(chain->constants.size());
+            chain->constants.push_back(0);
+            chain->constant_strings.emplace_back();
+            try {
+              WriteValue(env, kind, values.Get(j), &chain->constants.back(),
+                         &chain->constant_strings.back());
+            } catch (Error& e) {
+              e.Set("message", String::New(env, StepPrefix(k) +
+                  "error setting argument " + std::to_string(j + 1) + " - " +
+                  e.Message()));
+              throw;
+            }
+            break;
+
+          case Source::kInput:
+            if (index >= chain->input_kinds.size())
+              chain->input_kinds.resize(index + 1, ValueKind::kVoid);
+            if (chain->input_kinds[index] == ValueKind::kVoid)
+              chain->input_kinds[index] = kind;
+            if (chain->input_kinds[index] != kind) {
+              throw TypeError::New(env, "chain(): input " +
+                  std::to_string(index) + " is used both as " +
+                  ValueKindName(chain->input_kinds[index]) + " and as " +
+                  ValueKindName(kind));
+            }
+            chain->keep_inputs = chain->keep_inputs ||
+                                 kind == ValueKind::kPointer ||
+                                 kind == ValueKind::kCString;
+            break;
+
+          case Source::kResult: {
+            if (index >= k) {
+              throw RangeError::New(env, StepPrefix(k) + "argument " +
+                  std::to_string(j + 1) + " refers to step " +
+                  std::to_string(index) + ", which doesn't run before it");
+            }
+            ValueKind rkind = chain->steps[index].plan->rkind;
+            if (!Compatible(rkind, kind)) {
+              throw TypeError::New(env, StepPrefix(k) + "argument " +
+                  std::to_string(j + 1) + " (" + ValueKindName(kind) +
+                  ") can't take the result of step " +
+                  std::to_string(index) + " (" + ValueKindName(rkind) + ")");
+            }
+            break;
+          }
+
+          default:
+            throw TypeError::New(env, StepPrefix(k) + "invalid argument source");
+        }
+
+        step.sources.push_back(source);
+        step.indices.push_back(index);
+      }
+
+      // the chain keeps the plan alive
+      step.plan->refs++;
+      chain->steps.push_back(std::move(step));
+    }
+
+    // all the steps run where the first one's function runs its calls, and
+    // count against its caps, which have to be their own too
+    for (size_t k = 1; k < chain->steps.size(); k++) {
+      CallPlan* first = chain->steps[0].plan;
+      CallPlan* plan = chain->steps[k].plan;
+      if (plan->uv_pool != first->uv_pool ||
+          plan->executor != first->executor) {
+        throw TypeError::New(env, StepPrefix(k) + "its function runs on "
+            "another pool or executor than the one of step 0");
+      }
+      if (plan->limits != first->limits) {
+        throw TypeError::New(env, StepPrefix(k) + "its function has another "
+            "limiter than the one of step 0");
+      }
+    }
+  } catch (...) {
+    for (Step& step : chain->steps)
+      CallPlan::Release(env, step.plan);
+    throw;
+  }
+
+  if (chain->steps.empty())
+    throw RangeError::New(env, "chain(): there are no steps");
+  for (size_t i = 0; i < chain->input_kinds.size(); i++) {
+    if (chain->input_kinds[i] == ValueKind::kVoid) {
+      for (Step& step : chain->steps)
+        CallPlan::Release(env, step.plan);
+      throw RangeError::New(env, "chain(): input " + std::to_string(i) +
+          " is never used");
+    }
+  }
+  chain->steps_desc = Reference<Object>::New(steps, 1);
+
+  CallChain* data = chain.release();
+  data->refs++;
+  Function run = Function::New(env, Async, "chain", data);
+  run.AddFinalizer(Release, data);
+  return run;
+}
+
+void CallChain::Release(Env env, CallChain* chain) {
+  if (--chain->refs > 0)
+    return;
+  for (Step& step : chain->steps)
+    CallPlan::Release(env, step.plan);
+  delete chain;
+}
+
+/*
+ * `chain(...inputs, callback[, options])`: converts the inputs, then runs all
+ * the steps on the thread pool of the steps' functions, and invokes
+ * `callback(err, results)` with the results of all of them. A step whose
+ * result violates its function's error policy ends the chain early; the
+ * Error then has the results up to that point as its `results`. The options
+ * are those of `CallPlan::Async()`, and apply to the chain as a whole.
+ * Without a callback, this returns a promise of the results.
+ *
+ * The request's `values` hold the raw results of the steps, the same results
+ * narrowed for passing them on as arguments, and the inputs.
+ */
+
+Value CallChain::Async(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  CallChain* chain = static_cast<CallChain*>(args.Data());
+  size_t argc = chain->input_kinds.size();
+  size_t num_steps = chain->steps.size();
+
+  size_t n = args.Length();
+  if (n < argc || n > argc + 2) {
+    throw TypeError::New(env, "Expected " + std::to_string(argc + 1) +
+        " arguments, got " + std::to_string(n));
+  }
+  // like `CallPlan::Async()`, a promise when there's no callback
+  Value options = args[argc + 1];
+  bool promise = !args[argc].IsFunction();
+  if (promise && n == argc + 1 && args[argc].IsObject()) {
+    options = args[argc];
+  } else if (promise && !args[argc].IsUndefined()) {
+    throw TypeError::New(env, "Expected a callback function as argument "
+        "number: " + std::to_string(argc));
+  }
+
+  // the steps' functions all share the pool and the caps (see `New()`)
+  CallPlan* first = chain->steps[0].plan;
+  if (!AsyncLimits::AdmitCall(chain->instance, first->limits))
+    return AsyncLimits::Refuse(env, promise);
+
+  WorkerPool* queue = nullptr;
+  if (!first->uv_pool) {
+    queue = first->executor != nullptr ? first->executor
+                                       : chain->instance->Pool();
+  }
+  AsyncCallParams* p = chain->instance->NewAsyncCall();
+  Value result = env.Undefined();
+  try {
+    p->SetCallOptions(env, options, first->timeout, first->priority, queue);
+    result = p->Track(env, promise);
+  } catch (...) {
+    chain->instance->FreeAsyncCall(p);
+    throw;
+  }
+  p->chain = chain;
+  p->result = FFI_OK;
+  p->values.resize(2 * num_steps + argc);
+  p->strings.resize(argc);
+  p->avalue.resize(chain->num_args);
+  uint64_t* results = p->values.data();
+  uint64_t* narrowed = results + num_steps;
+  uint64_t* inputs = narrowed + num_steps;
+
+  size_t i = 0;
+  try {
+    for (i = 0; i < argc; i++) {
+      WriteValue(env, chain->input_kinds[i], args[i], &inputs[i],
+                 &p->strings[i]);
+    }
+  } catch (Error& e) {
+    // reported to the callback instead, like `CallPlan::Async()` does
+    p->result = FFI_ASYNC_ERROR;
+    p->err = "error setting argument " + std::to_string(i) + " - " +
+             e.Message();
+  }
+
+  for (const Step& step : chain->steps) {
+    void** avalue = p->avalue.data() + step.avalue_offset;
+    for (size_t j = 0; j < step.sources.size(); j++) {
+      uint32_t index = step.indices[j];
+      switch (step.sources[j]) {
+        case Source::kConstant: avalue[j] = &chain->constants[index]; break;
+        case Source::kInput: avalue[j] = &inputs[index]; break;
+        case Source::kResult: avalue[j] = &narrowed[index]; break;
+      }
+    }
+  }
+
+  if (chain->pending.IsEmpty())
+    chain->pending = Reference<Object>::New(Array::New(env), 1);
+  if (chain->free_slots.empty()) {
+    p->slot = chain->num_slots++;
+  } else {
+    p->slot = chain->free_slots.back();
+    chain->free_slots.pop_back();
+  }
+  Object pending = chain->pending.Value();
+  pending.Set(2 * p->slot, promise ? env.Undefined() : args[argc]);
+  if (chain->keep_inputs) {
+    Array keep = Array::New(env, argc);
+    for (uint32_t n = 0; n < argc; n++)
+      keep.Set(n, args[n]);
+    pending.Set(2 * p->slot + 1, keep);
+  }
+
+  chain->refs++;
+  p->req.data = p;
+  p->Submit(chain->instance, first->limits);
+  if (queue == nullptr) {
+    uv_loop_t* loop = nullptr;
+    napi_get_uv_event_loop(env, &loop);
+    uv_queue_work(loop, &p->req, Work, Finish);
+  } else {
+    queue->Queue(&p->req, Work, Finish, p->priority);
+  }
+  return result;
+}
+
+/*
+ * Called on the thread pool: runs the steps one after the other.
+ */
+
+void CallChain::Work(uv_work_t* req) {
+  AsyncCallParams* p = static_cast<AsyncCallParams*>(req->data);
+  CallChain* chain = p->chain;
+  size_t num_steps = chain->steps.size();
+  p->failed_step = num_steps;
+  if (p->result != FFI_OK || !p->Start())
+    return;
+
+  uint64_t* results = p->values.data();
+  uint64_t* narrowed = results + num_steps;
+  for (size_t k = 0; k < num_steps; k++) {
+    CallPlan* plan = chain->steps[k].plan;
+    void** avalue = p->avalue.data() + chain->steps[k].avalue_offset;
+
+    // the thunk takes the argument values in registers
+    uint64_t ints[kMaxThunkInts];
+    double doubles[kMaxThunkDoubles];
+    plan->LoadRegisters(avalue, ints, doubles);
+
+    p->errnum = plan->Execute(&results[k], avalue, ints, doubles);
+    if (ResultIsError(plan->error_options.policy, plan->rkind, &results[k])) {
+      p->failed_step = k;
+      break;
+    }
+    narrowed[k] = results[k];
+    NarrowResult(plan->rkind, &narrowed[k]);
+  }
+  p->Stop();
+}
+
+/*
+ * Called on the loop thread once `Work()` is done.
+ */
+
+void CallChain::Finish(uv_work_t* req, int status) {
+  AsyncCallParams* p = static_cast<AsyncCallParams*>(req->data);
+  CallChain* chain = p->chain;
+  Env env = p->env;
+  HandleScope scope(env);
+  size_t num_steps = chain->steps.size();
+
+  Object pending = chain->pending.Value();
+  Value callback = pending.Get(2 * p->slot);
+  pending.Set(2 * p->slot, env.Undefined());
+  pending.Set(2 * p->slot + 1, env.Undefined());
+  chain->free_slots.push_back(p->slot);
+
+  std::vector<napi_value> argv = { env.Null() };
+  if (p->result != FFI_OK) {
+    argv[0] = Error::New(env, p->err).Value();
+  } else if (p->Dropped()) {
+    argv[0] = p->DroppedError(env).Value();
+  } else {
+    // up to and including the failed step, if any
+    size_t done = std::min(p->failed_step + 1, num_steps);
+    Array results = Array::New(env, done);
+    for (size_t k = 0; k < done; k++) {
+      results.Set(k, chain->steps[k].plan->DecodeResult(env,
+                                                        &p->values[k]));
+    }
+
+    if (p->failed_step < num_steps) {
+      const CallPlan* plan = chain->steps[p->failed_step].plan;
+      Error e = ErrnoError(env, p->errnum, plan->error_options.name);
+      e.Set("message", String::New(env, StepPrefix(p->failed_step) +
+          e.Message()));
+      e.Set("step", Number::New(env, static_cast<double>(p->failed_step)));
+      e.Set("results", results);
+      argv[0] = e.Value();
+    } else {
+      argv.push_back(results);
+    }
+  }
+
+  // done with the request and the chain before the callback can throw
+  Release(env, chain);
+  p->Deliver(env, callback, argv);
+}
+
+}  // namespace FFI
@@ -0,0 +1,411 @@
+#include <string.h>
+#include <algorithm>
+#include "ffi.h"
+
+namespace FFI {
+
+/*
+ * Machine code call stubs for x86-64 System V.
+ *
+ * `ffi_call()` classifies every argument of the cif again on each call, then
+ * copies the values into a register block for the assembly trampoline to
+ * load. A call stub does that classification once, when it gets generated,
+ * and is a straight-line sequence of loads into the argument registers and
+ * stack slots, followed by the call and the stores of the return value.
+ *
+ * The stub has the same signature as `ffi_call()` minus the cif (see
+ * `CallStub` in ffi.h), and writes the return value to `rvalue` the same way
+ * `ffi_call()` does (integers widened to a full `ffi_arg`). The code lives
+ * in memory obtained from `ffi_closure_alloc()`, so that whatever the
+ * platform requires for executable memory (separate writable and executable
+ * mappings included) is taken care of by libffi.
+ */
+
+#if defined(__x86_64__) && !defined(_WIN32) && !defined(__ILP32__)
+#define FFI_HAS_CALL_STUBS 1
+#endif
+
+#ifdef FFI_HAS_CALL_STUBS
+
+extern "C" int ffi_unix64_classify(ffi_type* type, int in_return, int classes[4]);
+
+namespace {
+
+enum Reg : uint8_t {
+  RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15
+};
+
+const Reg kArgRegs[] = { RDI, RSI, RDX, RCX, R8, R9 };
+const int kMaxGprRegs = 6;
+const int kMaxSseRegs = 8;
+
+enum ClassKind { kNoClass = 0, kGprClass = 1, kSseClass = 2 };
+
+// the callee-saved registers holding the stub's own arguments
+const Reg kFn = R12;
+const Reg kRvalue = RBX;
+const Reg kAvalue = R13;
+
+/*
+ * Just enough of an x86-64 assembler for the stubs. Memory operands are
+ * always `[base + disp32]`.
+ */
+
+class Assembler {
+  public:
+    std::vector<uint8_t> code;
+
+    void Byte(uint8_t b) { code.push_back(b); }
+
+    void Int32(int32_t v) {
+      uint8_t buf[4];
+      memcpy(buf, &v, sizeof(buf));
+      code.insert(code.end(), buf, buf + sizeof(buf));
+    }
+
+    void Rex(bool w, int reg, int base, bool force = false) {
+      uint8_t rex = 0x40 | (w ? 8 : 0) | ((reg & 8) ? 4 : 0) | ((base & 8) ? 1 : 0);
+      if (rex != 0x40 || force)
+        Byte(rex);
+    }
+
+    // `prefix` (0 for none), REX, the opcode bytes, then ModRM `[base + disp]`
+    void Mem(uint8_t prefix, bool w, std::initializer_list<uint8_t> opcode,
+             int reg, Reg base, int32_t disp, bool force_rex = false) {
+      if (prefix != 0)
+        Byte(prefix);
+      Rex(w, reg, base, force_rex);
+      for (uint8_t b : opcode)
+        Byte(b);
+      Byte(0x80 | ((reg & 7) << 3) | (base & 7));
+      if ((base & 7) == RSP)
+        Byte(0x24);  // SIB: no index
+      Int32(disp);
+    }
+
+    void Push(Reg r) { Rex(false, 0, r); Byte(0x50 | (r & 7)); }
+    void Pop(Reg r) { Rex(false, 0, r); Byte(0x58 | (r & 7)); }
+
+    // mov dst, src (64-bit)
+    void Mov(Reg dst, Reg src) {
+      Rex(true, src, dst);
+      Byte(0x89);
+      Byte(0xC0 | ((src & 7) << 3) | (dst & 7));
+    }
+
+    // mov dst, [base + disp], zero- or sign-extending `size` bytes
+    void Load(Reg dst, Reg base, int32_t disp, size_t size, bool sign = false) {
+      switch (size) {
+        case 1: Mem(0, sign, { 0x0F, uint8_t(sign ? 0xBE : 0xB6) }, dst, base, disp); break;
+        case 2: Mem(0, sign, { 0x0F, uint8_t(sign ? 0xBF : 0xB7) }, dst, base, disp); break;
+        case 4: Mem(0, sign, { uint8_t(sign ? 0x63 : 0x8B) }, dst, base, disp); break;
+        default: Mem(0, true, { 0x8B }, dst, base, disp); break;
+      }
+    }
+
+    // mov [base + disp], src, storing the low `size` bytes
+    void Store(Reg base, int32_t disp, Reg src, size_t size) {
+      switch (size) {
+        case 1: Mem(0, false, { 0x88 }, src, base, disp, true); break;
+        case 2: Mem(0x66, false, { 0x89 }, src, base, disp); break;
+        case 4: Mem(0, false, { 0x89 }, src, base, disp); break;
+        default: Mem(0, true, { 0x89 }, src, base, disp); break;
+      }
+    }
+
+    // movd/movq xmm, [base + disp]
+    void LoadXmm(int xmm, Reg base, int32_t disp, size_t size) {
+      if (size == 4)
+        Mem(0x66, false, { 0x0F, 0x6E }, xmm, base, disp);
+      else
+        Mem(0xF3, false, { 0x0F, 0x7E }, xmm, base, disp);
+    }
+
+    // movd/movq [base + disp], xmm
+    void StoreXmm(Reg base, int32_t disp, int xmm, size_t size) {
+      if (size == 4)
+        Mem(0x66, false, { 0x0F, 0x7E }, xmm, base, disp);
+      else
+        Mem(0x66, false, { 0x0F, 0xD6 }, xmm, base, disp);
+    }
+
+    // copies `size` bytes from `[src + soff]` to `[dst + doff]` through R11
+    void Copy(Reg dst, int32_t doff, Reg src, int32_t soff, size_t size) {
+      for (size_t chunk = 8; chunk > 0; chunk /= 2) {
+        while (size >= chunk) {
+          Load(R11, src, soff, chunk);
+          Store(dst, doff, R11, chunk);
+          soff += chunk;
+          doff += chunk;
+          size -= chunk;
+        }
+      }
+    }
+
+    void MovImm32(Reg dst, int32_t imm) {  // mov r32, imm32
+      Rex(false, 0, dst);
+      Byte(0xB8 | (dst & 7));
+      Int32(imm);
+    }
+
+    void StoreImm32(Reg base, int32_t disp, int32_t imm) {  // mov qword [m], imm32
+      Mem(0, true, { 0xC7 }, 0, base, disp);
+      Int32(imm);
+    }
+
+    void SubRsp(int32_t imm) {  // sub rsp, imm32
+      Byte(0x48); Byte(0x81); Byte(0xEC); Int32(imm);
+    }
+
+    void Lea(Reg dst, Reg base, int32_t disp) {
+      Mem(0, true, { 0x8D }, dst, base, disp);
+    }
+
+    void CallReg(Reg r) {
+      Rex(false, 0, r);
+      Byte(0xFF);
+      Byte(0xD0 | (r & 7));
+    }
+
+    void Ret() { Byte(0xC3); }
+};
+
+size_t AlignUp(size_t size, size_t align) {
+  return (size + align - 1) / align * align;
+}
+
+bool IsAggregate(ffi_type* type) {
+  return type->type == FFI_TYPE_STRUCT || type->type == FFI_TYPE_COMPLEX;
+}
+
+// how scalar integers are extended to a full register, as `ffi_call()` does
+void ScalarExtension(ffi_type* type, size_t* size, bool* sign) {
+  *size = type->size;
+  *sign = false;
+  switch (type->type) {
+    case FFI_TYPE_SINT8:
+    case FFI_TYPE_SINT16:
+    case FFI_TYPE_SINT32:
+    case FFI_TYPE_INT:
+      *sign = true;
+      break;
+    default:
+      break;
+  }
+}
+
+}  // anonymous namespace
+
+/*
+ * Generates the call stub for the given cif. Returns nullptr when the cif
+ * can't be called through a stub (other ABIs, x87 return values), in which
+ * case `ffi_call()` needs to be used. On success, `*writable` receives the
+ * address to pass to `FreeCallStub()`.
+ */
+
+CallStub NewCallStub(ffi_cif* cif, void** writable) {
+  if (cif->abi != FFI_UNIX64)
+    return nullptr;
+
+  int classes[4];
+  int arg_classes[4];
+  ffi_type* rtype = cif->rtype;
+  int rn = 0;
+  bool ret_in_mem = false;
+
+  if (rtype->type == FFI_TYPE_STRUCT || rtype->type == FFI_TYPE_COMPLEX) {
+    rn = ffi_unix64_classify(rtype, 1, classes);
+    ret_in_mem = rn == 0;
+    for (int j = 0; j < rn; j++) {
+      if (classes[j] < 0)
+        return nullptr;
+    }
+  }
+#if FFI_TYPE_LONGDOUBLE != FFI_TYPE_DOUBLE
+  if (rtype->type == FFI_TYPE_LONGDOUBLE)
+    return nullptr;
+#endif
+
+  // the stack arguments, laid out like `ffi_call()` does, plus 8 bytes of
+  // scratch space for partial eightbytes
+  size_t stack_bytes = 0;
+  int ngpr = ret_in_mem ? 1 : 0;
+  int nsse = 0;
+  std::vector<int32_t> stack_offsets(cif->nargs, -1);
+  for (unsigned i = 0; i < cif->nargs; i++) {
+    ffi_type* type = cif->arg_types[i];
+    int n = ffi_unix64_classify(type, 0, arg_classes);
+    int g = 0;
+    int s = 0;
+    for (int j = 0; j < n; j++) {
+      if (arg_classes[j] < 0)
+        return nullptr;
+      g += arg_classes[j] == kGprClass;
+      s += arg_classes[j] == kSseClass;
+    }
+    if (n == 0 || ngpr + g > kMaxGprRegs || nsse + s > kMaxSseRegs) {
+      size_t align = std::max<size_t>(type->alignment, 8);
+      stack_bytes = AlignUp(stack_bytes, align);
+      stack_offsets[i] = static_cast<int32_t>(stack_bytes);
+      stack_bytes += type->size;
+    } else {
+      ngpr += g;
+      nsse += s;
+    }
+  }
+  const int32_t scratch = static_cast<int32_t>(AlignUp(stack_bytes, 8));
+  const int32_t frame = static_cast<int32_t>(AlignUp(scratch + 8, 16));
+
+  Assembler a;
+
+  // prologue: after these 5 pushes, rsp is 16-byte aligned again
+  a.Push(RBP);
+  a.Mov(RBP, RSP);
+  a.Push(RBX);
+  a.Push(R12);
+  a.Push(R13);
+  a.Push(R14);
+  a.Mov(kFn, RDI);
+  a.Mov(kRvalue, RSI);
+  a.Mov(kAvalue, RDX);
+  a.SubRsp(frame);
+
+  // stack arguments first, so that the argument registers are free to use
+  for (unsigned i = 0; i < cif->nargs; i++) {
+    if (stack_offsets[i] < 0)
+      continue;
+    a.Load(RAX, kAvalue, static_cast<int32_t>(i * sizeof(void*)), 8);
+    a.Copy(RSP, stack_offsets[i], RAX, 0, cif->arg_types[i]->size);
+  }
+
+  // now the register arguments
+  int gpr = 0;
+  int sse = 0;
+  if (ret_in_mem)
+    a.Mov(kArgRegs[gpr++], kRvalue);
+  for (unsigned i = 0; i < cif->nargs; i++) {
+    if (stack_offsets[i] >= 0)
+      continue;
+    ffi_type* type = cif->arg_types[i];
+    int n = ffi_unix64_classify(type, 0, arg_classes);
+    a.Load(RAX, kAvalue, static_cast<int32_t>(i * sizeof(void*)), 8);
+
+    if (!IsAggregate(type)) {
+      if (arg_classes[0] == kSseClass) {
+        a.LoadXmm(sse++, RAX, 0, type->size);
+      } else {
+        size_t size;
+        bool sign;
+        ScalarExtension(type, &size, &sign);
+        a.Load(kArgRegs[gpr++], RAX, 0, size, sign);
+      }
+      continue;
+    }
+
+    for (int j = 0; j < n; j++) {
+      int32_t off = j * 8;
+      size_t size = std::min<size_t>(8, type->size - off);
+      if (arg_classes[j] == kSseClass) {
+        a.LoadXmm(sse++, RAX, off, size == 4 ? 4 : 8);
+      } else if (arg_classes[j] == kGprClass) {
+        if (size < 8) {
+          a.StoreImm32(RSP, scratch, 0);
+          a.Copy(RSP, scratch, RAX, off, size);
+          a.Load(kArgRegs[gpr++], RSP, scratch, 8);
+        } else {
+          a.Load(kArgRegs[gpr++], RAX, off, 8);
+        }
+      }
+    }
+  }
+
+  // the number of vector registers used, for variadic functions
+  a.MovImm32(RAX, sse);
+  a.CallReg(kFn);
+
+  // the return value
+  switch (rtype->type) {
+    case FFI_TYPE_VOID:
+      break;
+    case FFI_TYPE_FLOAT:
+      a.StoreXmm(kRvalue, 0, 0, 4);
+      break;
+    case FFI_TYPE_DOUBLE:
+      a.StoreXmm(kRvalue, 0, 0, 8);
+      break;
+    case FFI_TYPE_STRUCT:
+    case FFI_TYPE_COMPLEX: {
+      if (ret_in_mem)
+        break;
+      int rgpr = 0;
+      int rsse = 0;
+      for (int j = 0; j < rn; j++) {
+        int32_t off = j * 8;
+        size_t size = std::min<size_t>(8, rtype->size - off);
+        if (classes[j] == kSseClass) {
+          int xmm = rsse++;
+          if (size == 8 || size == 4) {
+            a.StoreXmm(kRvalue, off, xmm, size);
+          } else {
+            a.StoreXmm(RSP, scratch, xmm, 8);
+            a.Copy(kRvalue, off, RSP, scratch, size);
+          }
+        } else if (classes[j] == kGprClass) {
+          Reg reg = rgpr++ == 0 ? RAX : RDX;
+          if (size == 8) {
+            a.Store(kRvalue, off, reg, 8);
+          } else {
+            a.Store(RSP, scratch, reg, 8);
+            a.Copy(kRvalue, off, RSP, scratch, size);
+          }
+        }
+      }
+      break;
+    }
+    default: {
+      // integers and pointers, widened to a full `ffi_arg`
+      size_t size;
+      bool sign;
+      ScalarExtension(rtype, &size, &sign);
+      a.Store(RSP, scratch, RAX, 8);
+      a.Load(RAX, RSP, scratch, size, sign);
+      a.Store(kRvalue, 0, RAX, 8);
+      break;
+    }
+  }
+
+  // epilogue
+  a.Lea(RSP, RBP, -32);
+  a.Pop(R14);
+  a.Pop(R13);
+  a.Pop(R12);
+  a.Pop(RBX);
+  a.Pop(RBP);
+  a.Ret();
+
+  void* code;
+  void* mem = ffi_closure_alloc(a.code.size(), &code);
+  if (mem == nullptr)
+    return nullptr;
+  memcpy(mem, a.code.data(), a.code.size());
+  *writable = mem;
+  return reinterpret_cast<CallStub>(code);
+}
+
+void FreeCallStub(void* writable) {
+  ffi_closure_free(writable);
+}
+
+#else
+
+CallStub NewCallStub(ffi_cif* cif, void** writable) {
+  return nullptr;
+}
+
+void FreeCallStub(void* writable) {
+}
+
+#endif  // FFI_HAS_CALL_STUBS
+
+}  // namespace FFI
@@ -0,0 +1,1263 @@
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "ffi.h"
+
+namespace FFI {
+
+namespace {
+
+// Integers in this range are returned as JS Numbers, others as Strings,
+// which is what "ref" does for 64-bit values.
+const double kMaxSafeInteger = 9007199254740991.0;
+
+/*
+ * Large enough (and aligned) for any single ValueKind value, and for the
+ * widened `ffi_arg` that libffi writes small integer return values into.
+ */
+
+union Slot {
+  int64_t i64;
+  uint64_t u64;
+  double d;
+  void* ptr;
+  ffi_arg arg;
+};
+
+/*
+ * A call frame on the C stack, used by `CallPlan::Invoke()` when the plan's
+ * preallocated frame is in use already. Calls with up to `kInlineArgs`
+ * arguments don't need any heap storage.
+ */
+
+class CallFrame {
+  public:
+    static const size_t kInlineArgs = 8;
+
+    explicit CallFrame(size_t argc) {
+      slots = inline_slots;
+      avalue = inline_avalue;
+      strings = inline_strings;
+      if (argc > kInlineArgs) {
+        heap_slots.reset(new Slot[argc]);
+        heap_avalue.reset(new void*[argc]);
+        heap_strings.reset(new std::string[argc]);
+        slots = heap_slots.get();
+        avalue = heap_avalue.get();
+        strings = heap_strings.get();
+      }
+      for (size_t i = 0; i < argc; i++)
+        avalue[i] = &slots[i];
+    }
+
+    Slot result;
+    Slot* slots;
+    void** avalue;
+    std::string* strings;
+
+  private:
+    Slot inline_slots[kInlineArgs];
+    void* inline_avalue[kInlineArgs];
+    std::string inline_strings[kInlineArgs];
+    std::unique_ptr<Slot[]> heap_slots;
+    std::unique_ptr<void*[]> heap_avalue;
+    std::unique_ptr<std::string[]> heap_strings;
+};
+
+/*
+ * Marks a CallPlan's preallocated frame as in use for the current call.
+ */
+
+struct BusyScope {
+  explicit BusyScope(CallPlan* plan) : plan(plan) { plan->busy = true; }
+  ~BusyScope() { plan->busy = false; }
+  CallPlan* plan;
+};
+
+RangeError OutOfRange(Env env, ValueKind kind) {
+  return RangeError::New(env, std::string("value is out of range for ") +
+      ValueKindName(kind));
+}
+
+// same semantics as `buf.writeInt32LE()` and friends: NaN becomes 0,
+// fractions are truncated and anything else out of range throws
+template <typename T>
+T DoubleToInteger(Env env, ValueKind kind, double d) {
+  if (std::isnan(d)) return 0;
+  if (d < static_cast<double>(std::numeric_limits<T>::min()) ||
+      d > static_cast<double>(std::numeric_limits<T>::max())) {
+    throw OutOfRange(env, kind);
+  }
+  return static_cast<T>(d);
+}
+
+int64_t DoubleToInt64(Env env, double d) {
+  if (std::isnan(d)) return 0;
+  if (d < -9223372036854775808.0 || d >= 9223372036854775808.0)
+    throw OutOfRange(env, ValueKind::kInt64);
+  return static_cast<int64_t>(d);
+}
+
+uint64_t DoubleToUint64(Env env, double d) {
+  if (std::isnan(d)) return 0;
+  if (d < 0 || d >= 18446744073709551616.0)
+    throw OutOfRange(env, ValueKind::kUint64);
+  return static_cast<uint64_t>(d);
+}
+
+/*
+ * Like "ref"'s `int8` and `uint8` setters, 8-bit integers can be given as a
+ * one-character String, which stands for its (first UTF-16) char code.
+ */
+
+template <typename T>
+T ToInteger(Env env, ValueKind kind, Value val) {
+  double d;
+  if (sizeof(T) == 1 && val.IsString()) {
+    char16_t unit[2] = { 0, 0 };
+    size_t length = 0;
+    napi_get_value_string_utf16(env, val, unit, 2, &length);
+    d = length > 0 ? unit[0] : 0;
+  } else if (val.IsBigInt()) {
+    bool lossless;
+    d = static_cast<double>(val.As<BigInt>().Int64Value(&lossless));
+  } else {
+    d = val.ToNumber().DoubleValue();
+  }
+  return DoubleToInteger<T>(env, kind, d);
+}
+
+int64_t ToInt64(Env env, Value val) {
+  if (val.IsBigInt()) {
+    bool lossless;
+    int64_t ret = val.As<BigInt>().Int64Value(&lossless);
+    if (!lossless) throw OutOfRange(env, ValueKind::kInt64);
+    return ret;
+  }
+  if (val.IsString()) {
+    std::string str = val.As<String>();
+    char* end;
+    errno = 0;
+    long long ret = strtoll(str.c_str(), &end, 10);
+    if (errno == ERANGE) throw OutOfRange(env, ValueKind::kInt64);
+    if (end == str.c_str() || *end != '\0')
+      throw TypeError::New(env, "could not parse int64 from \"" + str + "\"");
+    return ret;
+  }
+  return DoubleToInt64(env, val.ToNumber().DoubleValue());
+}
+
+uint64_t ToUint64(Env env, Value val) {
+  if (val.IsBigInt()) {
+    bool lossless;
+    uint64_t ret = val.As<BigInt>().Uint64Value(&lossless);
+    if (!lossless) throw OutOfRange(env, ValueKind::kUint64);
+    return ret;
+  }
+  if (val.IsString()) {
+    std::string str = val.As<String>();
+    char* end;
+    errno = 0;
+    unsigned long long ret = strtoull(str.c_str(), &end, 10);
+    if (errno == ERANGE || str[0] == '-')
+      throw OutOfRange(env, ValueKind::kUint64);
+    if (end == str.c_str() || *end != '\0')
+      throw TypeError::New(env, "could not parse uint64 from \"" + str + "\"");
+    return ret;
+  }
+  return DoubleToUint64(env, val.ToNumber().DoubleValue());
+}
+
+void* ToPointer(Env env, Value val) {
+  if (val.IsNull() || val.IsUndefined())
+    return nullptr;
+  if (!val.IsBuffer())
+    throw TypeError::New(env, "Buffer instance expected for pointer value");
+  return GetBufferData<void>(val);
+}
+
+Value Int64ToValue(Env env, int64_t val) {
+  if (val < -kMaxSafeInteger || val > kMaxSafeInteger)
+    return String::New(env, std::to_string(val));
+  return Number::New(env, static_cast<double>(val));
+}
+
+Value Uint64ToValue(Env env, uint64_t val) {
+  if (val > kMaxSafeInteger)
+    return String::New(env, std::to_string(val));
+  return Number::New(env, static_cast<double>(val));
+}
+
+template <typename T>
+T Load(const void* src) {
+  T ret;
+  memcpy(&ret, src, sizeof(ret));
+  return ret;
+}
+
+template <typename T>
+void StoreNarrowed(void* rvalue) {
+  T val = static_cast<T>(Load<ffi_arg>(rvalue));
+  memcpy(rvalue, &val, sizeof(val));
+}
+
+template <typename T, typename W>
+void StoreWidened(void* rvalue) {
+  W val = static_cast<W>(Load<T>(rvalue));
+  memcpy(rvalue, &val, sizeof(val));
+}
+
+/*
+ * One argument column of `CallPlan::Map()`: a TypedArray, or a scalar that
+ * has been converted once and gets passed to every call.
+ */
+
+struct Column {
+  napi_typedarray_type type;
+  const char* data;  // nullptr for a scalar
+  Slot scalar;
+};
+
+napi_typedarray_type TypedArrayTypeOf(ValueKind kind) {
+  switch (kind) {
+    case ValueKind::kInt8: return napi_int8_array;
+    case ValueKind::kUint8:
+    case ValueKind::kBool: return napi_uint8_array;
+    case ValueKind::kInt16: return napi_int16_array;
+    case ValueKind::kUint16: return napi_uint16_array;
+    case ValueKind::kInt32: return napi_int32_array;
+    case ValueKind::kUint32: return napi_uint32_array;
+    case ValueKind::kInt64: return napi_bigint64_array;
+    case ValueKind::kUint64: return napi_biguint64_array;
+    case ValueKind::kFloat: return napi_float32_array;
+    case ValueKind::kDouble: return napi_float64_array;
+    default: return static_cast<napi_typedarray_type>(-1);
+  }
+}
+
+double ElementAsDouble(napi_typedarray_type type, const char* data, size_t i) {
+  switch (type) {
+    case napi_int8_array: return Load<int8_t>(data + i);
+    case napi_uint8_array:
+    case napi_uint8_clamped_array: return Load<uint8_t>(data + i);
+    case napi_int16_array: return Load<int16_t>(data + i * 2);
+    case napi_uint16_array: return Load<uint16_t>(data + i * 2);
+    case napi_int32_array: return Load<int32_t>(data + i * 4);
+    case napi_uint32_array: return Load<uint32_t>(data + i * 4);
+    case napi_float32_array: return Load<float>(data + i * 4);
+    case napi_float64_array: return Load<double>(data + i * 8);
+    case napi_bigint64_array:
+      return static_cast<double>(Load<int64_t>(data + i * 8));
+    case napi_biguint64_array:
+      return static_cast<double>(Load<uint64_t>(data + i * 8));
+  }
+  return 0;
+}
+
+/*
+ * Converts element `i` of a TypedArray column according to `kind`, with the
+ * same rules as `WriteValue()` uses for Numbers (and BigInts).
+ */
+
+void WriteElement(Env env, ValueKind kind, const Column& col, size_t i,
+                  void* dst) {
+  if (kind == ValueKind::kInt64 && col.type == napi_bigint64_array) {
+    memcpy(dst, col.data + i * 8, 8);
+    return;
+  }
+  if (kind == ValueKind::kUint64 && col.type == napi_biguint64_array) {
+    memcpy(dst, col.data + i * 8, 8);
+    return;
+  }
+  if (kind == ValueKind::kInt64 && col.type == napi_biguint64_array) {
+    uint64_t val = Load<uint64_t>(col.data + i * 8);
+    if (val > static_cast<uint64_t>(std::numeric_limits<int64_t>::max()))
+      throw OutOfRange(env, kind);
+    memcpy(dst, &val, 8);
+    return;
+  }
+  if (kind == ValueKind::kUint64 && col.type == napi_bigint64_array) {
+    int64_t val = Load<int64_t>(col.data + i * 8);
+    if (val < 0)
+      throw OutOfRange(env, kind);
+    memcpy(dst, &val, 8);
+    return;
+  }
+
+  double d = ElementAsDouble(col.type, col.data, i);
+  switch (kind) {
+    case ValueKind::kInt8:
+      *static_cast<int8_t*>(dst) = DoubleToInteger<int8_t>(env, kind, d);
+      break;
+    case ValueKind::kUint8:
+      *static_cast<uint8_t*>(dst) = DoubleToInteger<uint8_t>(env, kind, d);
+      break;
+    case ValueKind::kInt16:
+      *static_cast<int16_t*>(dst) = DoubleToInteger<int16_t>(env, kind, d);
+      break;
+    case ValueKind::kUint16:
+      *static_cast<uint16_t*>(dst) = DoubleToInteger<uint16_t>(env, kind, d);
+      break;
+    case ValueKind::kInt32:
+      *static_cast<int32_t*>(dst) = DoubleToInteger<int32_t>(env, kind, d);
+      break;
+    case ValueKind::kUint32:
+      *static_cast<uint32_t*>(dst) = DoubleToInteger<uint32_t>(env, kind, d);
+      break;
+    case ValueKind::kInt64:
+      *static_cast<int64_t*>(dst) = DoubleToInt64(env, d);
+      break;
+    case ValueKind::kUint64:
+      *static_cast<uint64_t*>(dst) = DoubleToUint64(env, d);
+      break;
+    case ValueKind::kFloat:
+      *static_cast<float*>(dst) = static_cast<float>(d);
+      break;
+    case ValueKind::kDouble:
+      *static_cast<double*>(dst) = d;
+      break;
+    case ValueKind::kBool:
+      *static_cast<uint8_t*>(dst) = d != 0 && !std::isnan(d) ? 1 : 0;
+      break;
+    default:
+      break;
+  }
+}
+
+}  // anonymous namespace
+
+const char* ValueKindName(ValueKind kind) {
+  static const char* const names[] = {
+    "void", "int8", "uint8", "int16", "uint16", "int32", "uint32", "int64",
+    "uint64", "float", "double", "bool", "pointer", "string"
+  };
+  return names[static_cast<int>(kind)];
+}
+
+size_t ValueKindSize(ValueKind kind) {
+  switch (kind) {
+    case ValueKind::kVoid: return 0;
+    case ValueKind::kInt8:
+    case ValueKind::kUint8:
+    case ValueKind::kBool: return 1;
+    case ValueKind::kInt16:
+    case ValueKind::kUint16: return 2;
+    case ValueKind::kInt32:
+    case ValueKind::kUint32:
+    case ValueKind::kFloat: return 4;
+    case ValueKind::kInt64:
+    case ValueKind::kUint64:
+    case ValueKind::kDouble: return 8;
+    case ValueKind::kPointer:
+    case ValueKind::kCString: return sizeof(void*);
+  }
+  return 0;
+}
+
+/*
+ * Converts `val` according to `kind` and writes it to `dst`, which must be
+ * large enough for the kind's native size. `str` provides storage for
+ * the converted JS String in the "string" case, and has to outlive the call
+ * that consumes `dst`.
+ */
+
+void WriteValue(Env env, ValueKind kind, Value val, void* dst, std::string* str) {
+  switch (kind) {
+    case ValueKind::kVoid:
+      throw TypeError::New(env, "cannot write a \"void\" value");
+    case ValueKind::kInt8:
+      *static_cast<int8_t*>(dst) = ToInteger<int8_t>(env, kind, val);
+      break;
+    case ValueKind::kUint8:
+      *static_cast<uint8_t*>(dst) = ToInteger<uint8_t>(env, kind, val);
+      break;
+    case ValueKind::kInt16:
+      *static_cast<int16_t*>(dst) = ToInteger<int16_t>(env, kind, val);
+      break;
+    case ValueKind::kUint16:
+      *static_cast<uint16_t*>(dst) = ToInteger<uint16_t>(env, kind, val);
+      break;
+    case ValueKind::kInt32:
+      *static_cast<int32_t*>(dst) = ToInteger<int32_t>(env, kind, val);
+      break;
+    case ValueKind::kUint32:
+      *static_cast<uint32_t*>(dst) = ToInteger<uint32_t>(env, kind, val);
+      break;
+    case ValueKind::kInt64:
+      *static_cast<int64_t*>(dst) = ToInt64(env, val);
+      break;
+    case ValueKind::kUint64:
+      *static_cast<uint64_t*>(dst) = ToUint64(env, val);
+      break;
+    case ValueKind::kFloat:
+      *static_cast<float*>(dst) =
+          static_cast<float>(val.ToNumber().DoubleValue());
+      break;
+    case ValueKind::kDouble:
+      *static_cast<double*>(dst) = val.ToNumber().DoubleValue();
+      break;
+    case ValueKind::kBool:
+      *static_cast<uint8_t*>(dst) = val.ToBoolean() ? 1 : 0;
+      break;
+    case ValueKind::kPointer:
+      *static_cast<void**>(dst) = ToPointer(env, val);
+      break;
+    case ValueKind::kCString:
+      if (val.IsString()) {
+        *str = val.As<String>();
+        *static_cast<const char**>(dst) = str->c_str();
+      } else {
+        *static_cast<void**>(dst) = ToPointer(env, val);
+      }
+      break;
+  }
+}
+
+/*
+ * Reads a value of the given `kind` from `src` and returns it as the JS value
+ * that the corresponding "ref" type's `get()` would have returned. Pointers
+ * are returned as Buffers here; callers take care of setting their "type".
+ * With `bigint` set, 64-bit integers are returned as BigInts instead.
+ */
+
+Value ReadValue(Env env, ValueKind kind, const void* src, bool bigint) {
+  switch (kind) {
+    case ValueKind::kVoid:
+      return env.Null();
+    case ValueKind::kInt8:
+      return Number::New(env, Load<int8_t>(src));
+    case ValueKind::kUint8:
+      return Number::New(env, Load<uint8_t>(src));
+    case ValueKind::kInt16:
+      return Number::New(env, Load<int16_t>(src));
+    case ValueKind::kUint16:
+      return Number::New(env, Load<uint16_t>(src));
+    case ValueKind::kInt32:
+      return Number::New(env, Load<int32_t>(src));
+    case ValueKind::kUint32:
+      return Number::New(env, Load<uint32_t>(src));
+    case ValueKind::kInt64:
+      if (bigint) return BigInt::New(env, Load<int64_t>(src));
+      return Int64ToValue(env, Load<int64_t>(src));
+    case ValueKind::kUint64:
+      if (bigint) return BigInt::New(env, Load<uint64_t>(src));
+      return Uint64ToValue(env, Load<uint64_t>(src));
+    case ValueKind::kFloat:
+      return Number::New(env, Load<float>(src));
+    case ValueKind::kDouble:
+      return Number::New(env, Load<double>(src));
+    case ValueKind::kBool:
+      return Boolean::New(env, Load<uint8_t>(src) != 0);
+    case ValueKind::kPointer:
+      return WrapPointer(env, Load<char*>(src));
+    case ValueKind::kCString: {
+      const char* str = Load<const char*>(src);
+      if (str == nullptr) return env.Null();
+      return String::New(env, str);
+    }
+  }
+  return env.Undefined();
+}
+
+/*
+ * libffi widens integral return values smaller than `ffi_arg` to a full
+ * `ffi_arg`. This converts such a value in-place to its actual width, so that
+ * `ReadValue()` works for results as well (even on big-endian machines).
+ */
+
+void NarrowResult(ValueKind kind, void* rvalue) {
+  switch (kind) {
+    case ValueKind::kInt8: StoreNarrowed<int8_t>(rvalue); break;
+    case ValueKind::kUint8:
+    case ValueKind::kBool: StoreNarrowed<uint8_t>(rvalue); break;
+    case ValueKind::kInt16: StoreNarrowed<int16_t>(rvalue); break;
+    case ValueKind::kUint16: StoreNarrowed<uint16_t>(rvalue); break;
+    case ValueKind::kInt32:
+      if (sizeof(ffi_arg) > 4) StoreNarrowed<int32_t>(rvalue);
+      break;
+    case ValueKind::kUint32:
+      if (sizeof(ffi_arg) > 4) StoreNarrowed<uint32_t>(rvalue);
+      break;
+    default:
+      break;
+  }
+}
+
+/*
+ * The reverse of `NarrowResult()`, for the return values of callbacks: libffi
+ * expects those to be widened to a full `ffi_arg` (`ffi_sarg` if signed).
+ * `rvalue` must be large enough for one.
+ */
+
+void WidenResult(ValueKind kind, void* rvalue) {
+  switch (kind) {
+    case ValueKind::kInt8: StoreWidened<int8_t, ffi_sarg>(rvalue); break;
+    case ValueKind::kUint8:
+    case ValueKind::kBool: StoreWidened<uint8_t, ffi_arg>(rvalue); break;
+    case ValueKind::kInt16: StoreWidened<int16_t, ffi_sarg>(rvalue); break;
+    case ValueKind::kUint16: StoreWidened<uint16_t, ffi_arg>(rvalue); break;
+    case ValueKind::kInt32:
+      if (sizeof(ffi_arg) > 4) StoreWidened<int32_t, ffi_sarg>(rvalue);
+      break;
+    case ValueKind::kUint32:
+      if (sizeof(ffi_arg) > 4) StoreWidened<uint32_t, ffi_arg>(rvalue);
+      break;
+    default:
+      break;
+  }
+}
+
+Value CallPlan::DecodeResult(Env env, void* rvalue) {
+  if (rkind == ValueKind::kPointer) {
+    TypedArray buf = WrapPointer(env, Load<char*>(rvalue), rsize);
+    if (!rtype.IsEmpty()) buf["type"] = rtype.Value();
+    return buf;
+  }
+  NarrowResult(rkind, rvalue);
+  return ReadValue(env, rkind, rvalue, bigint);
+}
+
+/*
+ * Tells whether a (widened) result of the given kind counts as a failure
+ * under the given policy.
+ */
+
+bool ResultIsError(ErrorPolicy policy, ValueKind kind, const void* rvalue) {
+  if (policy == ErrorPolicy::kNone)
+    return false;
+
+  Slot result;
+  memcpy(&result, rvalue, std::max(sizeof(ffi_arg), ValueKindSize(kind)));
+  NarrowResult(kind, &result);
+
+  double value;
+  switch (kind) {
+    case ValueKind::kInt8: value = Load<int8_t>(&result); break;
+    case ValueKind::kUint8:
+    case ValueKind::kBool: value = Load<uint8_t>(&result); break;
+    case ValueKind::kInt16: value = Load<int16_t>(&result); break;
+    case ValueKind::kUint16: value = Load<uint16_t>(&result); break;
+    case ValueKind::kInt32: value = Load<int32_t>(&result); break;
+    case ValueKind::kUint32: value = Load<uint32_t>(&result); break;
+    case ValueKind::kInt64: value = static_cast<double>(result.i64); break;
+    case ValueKind::kUint64: value = static_cast<double>(result.u64); break;
+    case ValueKind::kFloat: value = Load<float>(&result); break;
+    case ValueKind::kDouble: value = result.d; break;
+    case ValueKind::kPointer:
+    case ValueKind::kCString:
+      // so that "negative" catches `(void *) -1`, as returned by `mmap()`
+      value = static_cast<double>(reinterpret_cast<intptr_t>(result.ptr));
+      break;
+    default:
+      return false;
+  }
+
+  switch (policy) {
+    case ErrorPolicy::kNegative: return value < 0;
+    case ErrorPolicy::kNonZero: return value != 0;
+    case ErrorPolicy::kZero: return value == 0;
+    default: return false;
+  }
+}
+
+/*
+ * Lays out the preallocated call frame: the result slot first (libffi needs
+ * at least an `ffi_arg` there), then every argument at its natural
+ * alignment. This happens once, so that a call only writes the argument
+ * values to fixed offsets.
+ */
+
+void CallPlan::PrepareFrame() {
+  std::vector<size_t> offsets;
+  size_t size = std::max(cif->rtype->size, sizeof(ffi_arg));
+
+  for (unsigned i = 0; i < cif->nargs; i++) {
+    ffi_type* type = cif->arg_types[i];
+    size_t align = type->alignment > 0 ? type->alignment : 1;
+    size = (size + align - 1) / align * align;
+    offsets.push_back(size);
+    size += type->size;
+  }
+
+  size_t units = (size + sizeof(max_align_t) - 1) / sizeof(max_align_t);
+  slab.reset(new max_align_t[units]);
+  char* base = reinterpret_cast<char*>(slab.get());
+  for (size_t offset : offsets)
+    avalue.push_back(base + offset);
+  strings.resize(cif->nargs);
+}
+
+/*
+ * Creates the native proxy function for a ForeignFunction.
+ *
+ * args[0] - Buffer - the `ffi_cif *`
+ * args[1] - Buffer - the C function pointer to invoke
+ * args[2] - Array - the ValueKind of the return value, followed by the
+ *           ValueKinds of the arguments
+ * args[3] - Object - for pointer return values, the "type" to set on them
+ * args[4] - Number - for pointer return values, the length of the Buffer
+ * args[5] - Boolean - whether the cif was prepared with `ffi_prep_cif_var()`
+ * args[6] - Buffer - the cif's call stub, if it has one
+ * args[7] - Boolean - return 64-bit integers as BigInts
+ * args[8] - Number - the error flags (see ErrorOptions)
+ * args[9] - String - the function's name, for error messages
+ * args[10] - Boolean - run `async()` calls on the libuv threadpool instead of
+ *            the FFI worker pool
+ * args[11] - Function - the completion handler for `async()` calls, if any
+ * args[12] - String - the key of the serial executor to run `async()` calls
+ *            on, if any
+ * args[13] - Number - the default timeout of `async()` calls in milliseconds
+ * args[14] - String - the default priority of `async()` calls
+ * args[15] - External - the caps on `async()` calls, besides the global ones,
+ *            if any (see `AsyncLimits`)
+ *
+ * returns a Function that takes the JS arguments and returns the JS result
+ */
+
+Value CallPlan::New(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  if (!args[0].IsBuffer() || !args[1].IsBuffer())
+    throw TypeError::New(env, "ffi_call_plan() requires 2 Buffer arguments!");
+  if (!args[2].IsArray())
+    throw TypeError::New(env, "ffi_call_plan() requires an Array of kinds");
+
+  ffi_cif* cif = GetBufferData<ffi_cif>(args[0]);
+  Array kinds = args[2].As<Array>();
+  if (kinds.Length() != cif->nargs + 1)
+    throw RangeError::New(env, "ffi_call_plan(): kinds do not match the cif");
+
+  std::unique_ptr<CallPlan> plan(new CallPlan());
+  plan->cif = cif;
+  plan->fn = GetBufferData<char>(args[1]);
+  plan->rkind = static_cast<ValueKind>(kinds.Get(0u).ToNumber().Uint32Value());
+  for (uint32_t i = 1; i < kinds.Length(); i++) {
+    ValueKind kind =
+        static_cast<ValueKind>(kinds.Get(i).ToNumber().Uint32Value());
+    plan->keep_args = plan->keep_args || kind == ValueKind::kPointer ||
+                      kind == ValueKind::kCString;
+    plan->kinds.push_back(kind);
+  }
+  if (args[3].IsObject())
+    plan->rtype = Reference<Object>::New(args[3].As<Object>(), 1);
+  plan->rsize = args[4].IsNumber() ? args[4].ToNumber().Uint32Value() : 0;
+  plan->bigint = args[7].ToBoolean();
+  plan->instance = InstanceData::Get(env);
+  plan->error_options.Parse(args[8], args[9]);
+  plan->uv_pool = args[10].ToBoolean();
+  if (args[11].IsFunction())
+    plan->completion_handler = Persistent(args[11].As<Function>());
+  if (args[12].IsString())
+    plan->executor = plan->instance->Executor(args[12].As<String>());
+  plan->timeout = args[13].ToNumber().Uint32Value();
+  plan->priority = ParsePriority(env, args[14], Priority::kNormal);
+  plan->limits = AsyncLimits::From(args[15]);
+  if (plan->limits != nullptr)
+    plan->limits->refs++;
+  plan->cif_buf = Reference<Object>::New(args[0].As<Object>(), 1);
+  plan->fn_buf = Reference<Object>::New(args[1].As<Object>(), 1);
+  plan->PrepareFrame();
+  plan->thunk = FindCallThunk(cif, args[5].ToBoolean(), plan->rkind,
+                              plan->kinds, &plan->thunk_slots);
+  if (plan->thunk == nullptr && args[6].IsBuffer()) {
+    plan->stub = reinterpret_cast<CallStub>(GetBufferData<char>(args[6]));
+    plan->stub_buf = Reference<Object>::New(args[6].As<Object>(), 1);
+  }
+
+  // each of the functions keeps the plan alive, as they may outlive the proxy
+  CallPlan* data = plan.release();
+  auto adopt = [data](Function fn) {
+    data->refs++;
+    fn.AddFinalizer(Release, data);
+    return fn;
+  };
+
+  Function proxy = adopt(Function::New(env, Invoke, "proxy", data));
+  // so that `CallChain::New()` can get to the plan
+  if (napi_wrap(env, proxy, data, nullptr, nullptr, nullptr) != napi_ok)
+    throw Error::New(env);
+  proxy["batch"] = adopt(Function::New(env, Batch, "batch", data));
+  proxy["map"] = adopt(Function::New(env, Map, "map", data));
+  proxy["async"] = adopt(Function::New(env, Async, "async", data));
+  if (data->thunk != nullptr)
+    proxy["callPath"] = "thunk";
+  else if (data->stub != nullptr)
+    proxy["callPath"] = "jit";
+  else
+    proxy["callPath"] = "libffi";
+  return proxy;
+}
+
+void CallPlan::Release(Env env, CallPlan* plan) {
+  if (--plan->refs > 0)
+    return;
+  if (plan->limits != nullptr)
+    AsyncLimits::Release(plan->limits);
+  delete plan;
+}
+
+/*
+ * Writes the JS arguments (anything indexable by argument number) to the
+ * thunk's register values when there is a thunk, to `avalue` otherwise.
+ * `i` is left at the argument that failed to convert, if any.
+ */
+
+template <typename Args>
+void CallPlan::Marshal(Env env, const Args& args, size_t* i,
+                       void** avalue, std::string* strings,
+                       uint64_t* ints, double* doubles) {
+  size_t argc = kinds.size();
+  for (*i = 0; *i < argc; ++*i) {
+    size_t n = *i;
+    if (thunk == nullptr) {
+      WriteValue(env, kinds[n], args[n], avalue[n], &strings[n]);
+    } else if (thunk_slots[n].fp) {
+      WriteValue(env, kinds[n], args[n], &doubles[thunk_slots[n].index],
+                 &strings[n]);
+    } else {
+      uint64_t* slot = &ints[thunk_slots[n].index];
+      WriteValue(env, kinds[n], args[n], slot, &strings[n]);
+      WidenInteger(kinds[n], slot);
+    }
+  }
+}
+
+/*
+ * For arguments that are already in native form, in `avalue`: copies them
+ * into the thunk's register values, if there is a thunk.
+ */
+
+void CallPlan::LoadRegisters(void** avalue,
+                             uint64_t* ints, double* doubles) const {
+  if (thunk == nullptr)
+    return;
+  for (size_t n = 0; n < kinds.size(); n++) {
+    const ThunkSlot& slot = thunk_slots[n];
+    if (slot.fp) {
+      memcpy(&doubles[slot.index], avalue[n], ValueKindSize(kinds[n]));
+    } else {
+      memcpy(&ints[slot.index], avalue[n], ValueKindSize(kinds[n]));
+      WidenInteger(kinds[n], &ints[slot.index]);
+    }
+  }
+}
+
+/*
+ * Marshals the JS arguments into the given frame and invokes the function.
+ * Returns false when a JS callback invoked during the call has thrown.
+ */
+
+template <typename Args>
+bool CallPlan::Call(Env env, const Args& args,
+                    void* rvalue, void** avalue, std::string* strings) {
+  size_t i = 0;
+
+  // register values for the thunk
+  uint64_t ints[kMaxThunkInts];
+  double doubles[kMaxThunkDoubles];
+
+  try {
+    Marshal(env, args, &i, avalue, strings, ints, doubles);
+  } catch (Error& e) {
+    // counting arguments from 1 is more human readable
+    e.Set("message", String::New(env, "error setting argument " +
+        std::to_string(i + 1) + " - " + e.Message()));
+    throw;
+  }
+
+  int errnum = Execute(rvalue, avalue, ints, doubles);
+  if (error_options.capture_errno)
+    instance->last_errno = errnum;
+
+  // a JS callback invoked during the call may have thrown
+  if (env.IsExceptionPending())
+    return false;
+  if (ResultIsError(error_options.policy, rkind, rvalue))
+    throw ErrnoError(env, errnum, error_options.name);
+  return true;
+}
+
+/*
+ * Invokes the function with arguments that have been written already (see
+ * `Marshal()`). Returns the `errno` the function left behind, if it is being
+ * captured. This may run on a worker thread, so it must not touch any JS
+ * values or mutable state of the plan.
+ */
+
+int CallPlan::Execute(void* rvalue, void** avalue,
+                      const uint64_t* ints, const double* doubles) {
+  if (error_options.capture_errno)
+    errno = 0;
+
+  if (thunk != nullptr) {
+    thunk(fn, ints, doubles, rvalue);
+  } else if (stub != nullptr) {
+    stub(FFI_FN(fn), rvalue, avalue);
+  } else {
+    ffi_call(cif, FFI_FN(fn), rvalue, avalue);
+  }
+
+  // read it before anything else gets a chance to overwrite it
+  return error_options.capture_errno ? errno : 0;
+}
+
+/*
+ * The JS proxy function of a ForeignFunction with a CallPlan.
+ */
+
+Value CallPlan::Invoke(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  CallPlan* plan = static_cast<CallPlan*>(args.Data());
+  size_t argc = plan->kinds.size();
+
+  if (args.Length() != argc) {
+    throw TypeError::New(env, "Expected " + std::to_string(argc) +
+        " arguments, got " + std::to_string(args.Length()));
+  }
+
+  if (plan->busy) {
+    CallFrame frame(argc);
+    if (!plan->Call(env, args, &frame.result, frame.avalue, frame.strings))
+      return env.Undefined();
+    return plan->DecodeResult(env, &frame.result);
+  }
+
+  BusyScope scope(plan);
+  void* rvalue = plan->slab.get();
+  if (!plan->Call(env, args, rvalue, plan->avalue.data(), plan->strings.data()))
+    return env.Undefined();
+  return plan->DecodeResult(env, rvalue);
+}
+
+/*
+ * `proxy.batch(calls)`: invokes the function once for every argument tuple,
+ * in order, within a single native call.
+ *
+ * args[0] - Array|TypedArray - either an Array of argument Arrays, or a flat
+ *           TypedArray holding the arguments of one call after the other
+ *
+ * returns a TypedArray with the results for number and bool return types,
+ * an Array of them for pointer and string return types, or `undefined` for
+ * void functions
+ */
+
+Value CallPlan::Batch(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  CallPlan* plan = static_cast<CallPlan*>(args.Data());
+  size_t argc = plan->kinds.size();
+
+  Object calls;
+  size_t count;
+  bool flat = args[0].IsTypedArray();
+  if (flat) {
+    calls = args[0].As<Object>();
+    size_t length = args[0].As<TypedArray>().ElementLength();
+    if (argc == 0 || length % argc != 0) {
+      throw RangeError::New(env, "batch(): expected a multiple of " +
+          std::to_string(argc) + " values, got " + std::to_string(length));
+    }
+    count = length / argc;
+  } else if (args[0].IsArray()) {
+    calls = args[0].As<Object>();
+    count = args[0].As<Array>().Length();
+  } else {
+    throw TypeError::New(env, "batch() requires an Array or a TypedArray");
+  }
+
+  Value results = env.Undefined();
+  char* out = nullptr;
+  size_t out_size = ValueKindSize(plan->rkind);
+  switch (plan->rkind) {
+    case ValueKind::kVoid: break;
+    case ValueKind::kInt8: results = Int8Array::New(env, count); break;
+    case ValueKind::kUint8: results = Uint8Array::New(env, count); break;
+    case ValueKind::kInt16: results = Int16Array::New(env, count); break;
+    case ValueKind::kUint16: results = Uint16Array::New(env, count); break;
+    case ValueKind::kInt32: results = Int32Array::New(env, count); break;
+    case ValueKind::kUint32: results = Uint32Array::New(env, count); break;
+    case ValueKind::kInt64: results = BigInt64Array::New(env, count); break;
+    case ValueKind::kUint64: results = BigUint64Array::New(env, count); break;
+    case ValueKind::kFloat: results = Float32Array::New(env, count); break;
+    case ValueKind::kDouble: results = Float64Array::New(env, count); break;
+    case ValueKind::kBool: results = Uint8Array::New(env, count); break;
+    default: results = Array::New(env, count); break;
+  }
+  if (results.IsTypedArray()) {
+    TypedArray array = results.As<TypedArray>();
+    out = static_cast<char*>(array.ArrayBuffer().Data()) + array.ByteOffset();
+  }
+
+  // the argument tuple of one call
+  struct Row {
+    Value operator[](size_t i) const {
+      return flat ? calls.Get(static_cast<uint32_t>(base + i))
+                  : tuple.Get(static_cast<uint32_t>(i));
+    }
+    bool flat;
+    Object calls;
+    Object tuple;
+    size_t base;
+  };
+
+  CallFrame frame(argc);
+  for (size_t n = 0; n < count; n++) {
+    HandleScope scope(env);
+    Row row = { flat, calls, Object(), n * argc };
+    if (!flat) {
+      Value tuple = calls.Get(static_cast<uint32_t>(n));
+      size_t length = tuple.IsArray() ? tuple.As<Array>().Length() : 0;
+      if (!tuple.IsArray() || length != argc) {
+        throw TypeError::New(env, "batch(): call " + std::to_string(n + 1) +
+            " - expected " + std::to_string(argc) + " arguments, got " +
+            std::to_string(length));
+      }
+      row.tuple = tuple.As<Object>();
+    }
+
+    try {
+      if (!plan->Call(env, row, &frame.result, frame.avalue, frame.strings))
+        return env.Undefined();
+    } catch (Error& e) {
+      e.Set("message", String::New(env, "batch(): call " +
+          std::to_string(n + 1) + " - " + e.Message()));
+      throw;
+    }
+
+    if (out != nullptr) {
+      NarrowResult(plan->rkind, &frame.result);
+      memcpy(out + n * out_size, &frame.result, out_size);
+    } else if (plan->rkind != ValueKind::kVoid) {
+      results.As<Object>().Set(static_cast<uint32_t>(n),
+                               plan->DecodeResult(env, &frame.result));
+    }
+  }
+
+  return results;
+}
+
+/*
+ * `proxy.map(out, ...columns)`: invokes the function once per element, in a
+ * native loop, for functions with number and bool types only.
+ *
+ * args[0] - TypedArray - receives the results; its element type has to match
+ *           the return type (`null` for void functions)
+ * args[1..n] - TypedArray|Number|BigInt|Boolean - an argument column of the
+ *              same length as `out`, or a value passed to every call
+ *
+ * returns `out`
+ */
+
+Value CallPlan::Map(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  CallPlan* plan = static_cast<CallPlan*>(args.Data());
+  size_t argc = plan->kinds.size();
+
+  for (ValueKind kind : plan->kinds) {
+    if (TypedArrayTypeOf(kind) == static_cast<napi_typedarray_type>(-1))
+      throw TypeError::New(env, "map() requires number or bool argument types");
+  }
+  if (args.Length() != argc + 1) {
+    throw TypeError::New(env, "map(): expected " + std::to_string(argc + 1) +
+        " arguments, got " + std::to_string(args.Length()));
+  }
+
+  // the results
+  const size_t npos = static_cast<size_t>(-1);
+  size_t length = npos;
+  char* out = nullptr;
+  size_t out_size = ValueKindSize(plan->rkind);
+  if (plan->rkind != ValueKind::kVoid) {
+    napi_typedarray_type type = TypedArrayTypeOf(plan->rkind);
+    if (type == static_cast<napi_typedarray_type>(-1))
+      throw TypeError::New(env, "map() requires a number or bool return type");
+    if (!args[0].IsTypedArray() ||
+        args[0].As<TypedArray>().TypedArrayType() != type) {
+      throw TypeError::New(env, std::string("map(): expected a TypedArray of ") +
+          ValueKindName(plan->rkind) + " for the results");
+    }
+    TypedArray array = args[0].As<TypedArray>();
+    out = static_cast<char*>(array.ArrayBuffer().Data()) + array.ByteOffset();
+    length = array.ElementLength();
+  }
+
+  // the arguments
+  std::vector<Column> columns(argc);
+  for (size_t i = 0; i < argc; i++) {
+    Value val = args[i + 1];
+    Column& col = columns[i];
+    if (val.IsTypedArray()) {
+      TypedArray array = val.As<TypedArray>();
+      if (length == npos) length = array.ElementLength();
+      if (array.ElementLength() != length) {
+        throw RangeError::New(env, "map(): argument " + std::to_string(i + 1) +
+            " has " + std::to_string(array.ElementLength()) +
+            " elements, expected " + std::to_string(length));
+      }
+      col.type = array.TypedArrayType();
+      col.data =
+          static_cast<char*>(array.ArrayBuffer().Data()) + array.ByteOffset();
+    } else {
+      col.data = nullptr;
+      try {
+        WriteValue(env, plan->kinds[i], val, &col.scalar, nullptr);
+      } catch (Error& e) {
+        e.Set("message", String::New(env, "map(): error setting argument " +
+            std::to_string(i + 1) + " - " + e.Message()));
+        throw;
+      }
+    }
+  }
+  if (length == npos)
+    throw TypeError::New(env, "map() requires at least one TypedArray");
+
+  CallFrame frame(argc);
+  uint64_t ints[kMaxThunkInts];
+  double doubles[kMaxThunkDoubles];
+  for (size_t n = 0; n < length; n++) {
+    size_t i = 0;
+    try {
+      for (i = 0; i < argc; i++) {
+        const Column& col = columns[i];
+        ValueKind kind = plan->kinds[i];
+        void* dst = frame.avalue[i];
+        if (plan->thunk != nullptr) {
+          const ThunkSlot& slot = plan->thunk_slots[i];
+          dst = slot.fp ? static_cast<void*>(&doubles[slot.index])
+                        : static_cast<void*>(&ints[slot.index]);
+        }
+        if (col.data == nullptr)
+          memcpy(dst, &col.scalar, ValueKindSize(kind));
+        else
+          WriteElement(env, kind, col, n, dst);
+        if (plan->thunk != nullptr && !plan->thunk_slots[i].fp)
+          WidenInteger(kind, &ints[plan->thunk_slots[i].index]);
+      }
+    } catch (Error& e) {
+      e.Set("message", String::New(env, "map(): element " +
+          std::to_string(n) + " - error setting argument " +
+          std::to_string(i + 1) + " - " + e.Message()));
+      throw;
+    }
+
+    int errnum = plan->Execute(&frame.result, frame.avalue, ints, doubles);
+    if (plan->error_options.capture_errno)
+      plan->instance->last_errno = errnum;
+    if (env.IsExceptionPending())
+      return env.Undefined();
+    if (ResultIsError(plan->error_options.policy, plan->rkind,
+                      &frame.result)) {
+      Error e = ErrnoError(env, errnum, plan->error_options.name);
+      e.Set("message", String::New(env, "map(): element " +
+          std::to_string(n) + " - " + e.Message()));
+      throw e;
+    }
+
+    if (out != nullptr) {
+      NarrowResult(plan->rkind, &frame.result);
+      memcpy(out + n * out_size, &frame.result, out_size);
+    }
+  }
+
+  return args[0];
+}
+
+/*
+ * `proxy.async(...args, callback[, options])`: marshals the arguments right
+ * away, runs the call on the FFI worker pool (or the libuv threadpool) and
+ * invokes `callback(err, result)` with the decoded result. The options can
+ * withdraw the call while it's still queued (see
+ * `AsyncCallParams::SetCallOptions()`).
+ *
+ * `proxy.async(...args[, options])`, without a callback, returns a promise
+ * of the decoded result instead. Either way, the outcome is delivered in the
+ * async context the call was made in.
+ *
+ * Nothing gets allocated per call once things are warmed up: the request
+ * object and its argument storage are reused, and rather than getting a
+ * reference of its own, the callback is stored in the plan's `pending` Array.
+ * With a completion handler, the last argument is an arbitrary tag instead.
+ */
+
+Value CallPlan::Async(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  CallPlan* plan = static_cast<CallPlan*>(args.Data());
+  size_t argc = plan->kinds.size();
+
+  size_t n = args.Length();
+  bool handled = !plan->completion_handler.IsEmpty();
+  if (n < (handled ? argc + 1 : argc) || n > argc + 2) {
+    throw TypeError::New(env, "Expected " + std::to_string(argc + 1) +
+        " arguments, got " + std::to_string(n));
+  }
+  // without a callback, the call returns a promise, and the options may
+  // take the callback's place
+  Value options = args[argc + 1];
+  bool promise = !handled && !args[argc].IsFunction();
+  if (promise && n == argc + 1 && args[argc].IsObject()) {
+    options = args[argc];
+  } else if (promise && !args[argc].IsUndefined()) {
+    throw TypeError::New(env, "Expected a callback function as argument "
+        "number: " + std::to_string(argc));
+  }
+
+  if (!AsyncLimits::AdmitCall(plan->instance, plan->limits))
+    return AsyncLimits::Refuse(env, promise);
+
+  WorkerPool* queue = nullptr;
+  if (!plan->uv_pool) {
+    queue = plan->executor != nullptr ? plan->executor
+                                      : plan->instance->Pool();
+  }
+  AsyncCallParams* p = plan->instance->NewAsyncCall();
+  Value result = env.Undefined();
+  try {
+    p->SetCallOptions(env, options, plan->timeout, plan->priority, queue);
+    // completions that go to the handler are delivered in batches, outside
+    // of any one call's context
+    if (!handled)
+      result = p->Track(env, promise);
+  } catch (...) {
+    plan->instance->FreeAsyncCall(p);
+    throw;
+  }
+  p->plan = plan;
+  p->result = FFI_OK;
+  p->values.resize(argc + 1);
+  p->avalue.resize(argc);
+  p->strings.resize(argc);
+  for (size_t i = 0; i < argc; i++)
+    p->avalue[i] = &p->values[i + 1];
+
+  size_t i = 0;
+  try {
+    plan->Marshal(env, args, &i, p->avalue.data(), p->strings.data(),
+                  p->ints, p->doubles);
+  } catch (Error& e) {
+    // reported to the callback instead, like JS-land's `async()` does
+    p->result = FFI_ASYNC_ERROR;
+    p->err = "error setting argument " + std::to_string(i) + " - " +
+             e.Message();
+  }
+
+  if (plan->pending.IsEmpty())
+    plan->pending = Reference<Object>::New(Array::New(env), 1);
+  if (plan->free_slots.empty()) {
+    p->slot = plan->num_slots++;
+  } else {
+    p->slot = plan->free_slots.back();
+    plan->free_slots.pop_back();
+  }
+  Object pending = plan->pending.Value();
+  pending.Set(2 * p->slot, promise ? env.Undefined() : args[argc]);
+  if (plan->keep_args) {
+    // the Buffers and strings that were passed must outlive the call
+    Array keep = Array::New(env, argc);
+    for (uint32_t n = 0; n < argc; n++)
+      keep.Set(n, args[n]);
+    pending.Set(2 * p->slot + 1, keep);
+  }
+
+  plan->refs++;
+  p->req.data = p;
+  p->Submit(plan->instance, plan->limits);
+  if (queue == nullptr) {
+    uv_loop_t* loop = nullptr;
+    napi_get_uv_event_loop(env, &loop);
+    uv_queue_work(loop, &p->req, AsyncWork, FinishAsync);
+  } else {
+    queue->Queue(&p->req, AsyncWork, FinishAsync, p->priority);
+  }
+  return result;
+}
+
+/*
+ * Called on the thread pool.
+ */
+
+void CallPlan::AsyncWork(uv_work_t* req) {
+  AsyncCallParams* p = static_cast<AsyncCallParams*>(req->data);
+  if (p->result != FFI_OK || !p->Start())
+    return;
+  p->errnum = p->plan->Execute(p->values.data(), p->avalue.data(),
+                               p->ints, p->doubles);
+  p->Stop();
+}
+
+/*
+ * Called on the loop thread once `AsyncWork()` is done.
+ */
+
+void CallPlan::FinishAsync(uv_work_t* req, int status) {
+  AsyncCallParams* p = static_cast<AsyncCallParams*>(req->data);
+  CallPlan* plan = p->plan;
+  Env env = p->env;
+  HandleScope scope(env);
+
+  Object pending = plan->pending.Value();
+  Value callback = pending.Get(2 * p->slot);
+  pending.Set(2 * p->slot, env.Undefined());
+  pending.Set(2 * p->slot + 1, env.Undefined());
+  plan->free_slots.push_back(p->slot);
+
+  std::vector<napi_value> argv = { env.Null() };
+  if (p->result != FFI_OK) {
+    argv[0] = Error::New(env, p->err).Value();
+  } else if (p->Dropped()) {
+    argv[0] = p->DroppedError(env).Value();
+  } else if (ResultIsError(plan->error_options.policy, plan->rkind,
+                           p->values.data())) {
+    argv[0] = ErrnoError(env, p->errnum, plan->error_options.name).Value();
+  } else {
+    argv.push_back(plan->DecodeResult(env, p->values.data()));
+    if (plan->error_options.capture_errno)
+      argv.push_back(Number::New(env, p->errnum));
+  }
+
+  // done with the request and the plan before the callback can throw
+  if (plan->completion_handler.IsEmpty()) {
+    Release(env, plan);
+    p->Deliver(env, callback, argv);
+    return;
+  }
+  plan->instance->FreeAsyncCall(p);
+
+  if (plan->completed.IsEmpty())
+    plan->completed = Reference<Object>::New(Array::New(env), 1);
+  Object completed = plan->completed.Value();
+  completed.Set(plan->num_completed++, callback);
+  completed.Set(plan->num_completed++, argv[0]);
+  completed.Set(plan->num_completed++,
+                argv.size() > 1 ? Value(env, argv[1]) : env.Undefined());
+  if (plan->num_completed > 3) {
+    // a flush is coming up already, and holds a reference of its own
+    Release(env, plan);
+    return;
+  }
+
+  // the call's reference to the plan is handed over to the flush
+  WorkerPool* pool =
+      plan->executor != nullptr ? plan->executor : plan->instance->pool;
+  if (plan->uv_pool || pool == nullptr || !pool->Defer(FlushCompletions, plan))
+    FlushCompletions(plan);
+}
+
+/*
+ * Delivers the collected completions to the completion handler.
+ */
+
+void CallPlan::FlushCompletions(void* data) {
+  CallPlan* plan = static_cast<CallPlan*>(data);
+  Env env = plan->instance->env;
+  HandleScope scope(env);
+
+  Value completed = plan->completed.Value();
+  plan->completed.Reset();
+  plan->num_completed = 0;
+  Function handler = plan->completion_handler.Value();
+  Release(env, plan);
+
+  handler.MakeCallback(env.Global(), { completed });
+}
+
+}  // namespace FFI
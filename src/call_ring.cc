@@ -0,0 +1,242 @@
+#include <string.h>
+#include <algorithm>
+#include "ffi.h"
+
+namespace FFI {
+
+namespace {
+
+// the ring indices live in the SharedArrayBuffers, where JS-land accesses
+// them with `Atomics`
+std::atomic<uint32_t>* Index(uint8_t* ring, size_t offset) {
+  return reinterpret_cast<std::atomic<uint32_t>*>(ring + offset);
+}
+
+uint8_t* RingData(Env env, Value view, size_t min_size) {
+  if (!view.IsTypedArray())
+    throw TypeError::New(env, "ffi_call_ring() requires Uint8Array views");
+  TypedArray array = view.As<TypedArray>();
+  if (array.ByteLength() < min_size)
+    throw RangeError::New(env, "ffi_call_ring(): the ring is too small");
+  // N-API has no accessor for SharedArrayBuffers, but it does give out the
+  // data of TypedArray views on them
+  void* data = nullptr;
+  napi_get_typedarray_info(env, array, nullptr, nullptr, &data, nullptr,
+                           nullptr);
+  return static_cast<uint8_t*>(data);
+}
+
+}  // anonymous namespace
+
+/*
+ * Sets up a ring pair for the given functions.
+ *
+ * args[0] - Uint8Array - a view of the whole submission ring
+ * args[1] - Uint8Array - a view of the whole completion ring
+ * args[2] - Array - the CallPlan proxies of the functions, by index
+ * args[3] - Number - the number of entries per ring, a power of 2
+ * args[4] - Function - invoked without arguments when a worker is done with
+ *           a batch of submissions, if any
+ * args[5] - String - the priority of that work on the FFI worker pool
+ *
+ * returns the `notify()` Function, which has a worker pick up the
+ * submissions
+ */
+
+Value CallRing::New(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  if (!args[2].IsArray())
+    throw TypeError::New(env, "ffi_call_ring() requires an Array of functions");
+  Array fns = args[2].As<Array>();
+  uint32_t entries = args[3].ToNumber().Uint32Value();
+  if (entries == 0 || (entries & (entries - 1)) != 0)
+    throw RangeError::New(env, "ffi_call_ring(): entries must be a power of 2");
+
+  std::unique_ptr<CallRing> ring(new CallRing());
+  ring->instance = InstanceData::Get(env);
+  ring->entries = entries;
+  ring->priority = ParsePriority(env, args[5], Priority::kNormal);
+
+  size_t max_args = 0;
+  for (uint32_t i = 0; i < fns.Length(); i++) {
+    void* data = nullptr;
+    Value fn = fns.Get(i);
+    if (!fn.IsFunction() || napi_unwrap(env, fn, &data) != napi_ok) {
+      throw TypeError::New(env, "ffi_call_ring(): function " +
+          std::to_string(i) + " - expected a ForeignFunction whose types are "
+          "all converted natively");
+    }
+    CallPlan* plan = static_cast<CallPlan*>(data);
+    if (plan->rkind == ValueKind::kCString ||
+        std::find(plan->kinds.begin(), plan->kinds.end(),
+                  ValueKind::kCString) != plan->kinds.end()) {
+      throw TypeError::New(env, "ffi_call_ring(): function " +
+          std::to_string(i) + " - strings can't be passed through a ring");
+    }
+    // the ring's worker runs on the shared pool, which would break the
+    // affinity of an executor's functions
+    if (plan->executor != nullptr || plan->uv_pool) {
+      throw TypeError::New(env, "ffi_call_ring(): function " +
+          std::to_string(i) + " - functions of an executor or the libuv "
+          "threadpool can't be called through a ring");
+    }
+    max_args = std::max(max_args, plan->kinds.size());
+    ring->plans.push_back(plan);
+  }
+
+  ring->entry_size = 8 + 8 * max_args;
+  ring->avalue.resize(max_args);
+  ring->sq = RingData(env, args[0],
+                      kEntriesOffset + entries * ring->entry_size);
+  ring->cq = RingData(env, args[1],
+                      kEntriesOffset + entries * kCompletionSize);
+  Array buffers = Array::New(env, 2);
+  buffers.Set(0u, args[0]);
+  buffers.Set(1u, args[1]);
+  ring->buffers = Reference<Object>::New(buffers, 1);
+  if (args[4].IsFunction())
+    ring->on_completion = Reference<Function>::New(args[4].As<Function>(), 1);
+
+  // the ring keeps the plans alive
+  for (CallPlan* plan : ring->plans)
+    plan->refs++;
+
+  CallRing* data = ring.release();
+  data->req.data = data;
+  data->refs++;
+  Function notify = Function::New(env, Notify, "notify", data);
+  notify.AddFinalizer(Release, data);
+  return notify;
+}
+
+void CallRing::Release(Env env, CallRing* ring) {
+  if (--ring->refs > 0)
+    return;
+  for (CallPlan* plan : ring->plans)
+    CallPlan::Release(env, plan);
+  delete ring;
+}
+
+/*
+ * Whether a worker could make progress: there are submissions, and room for
+ * their completions.
+ */
+
+bool CallRing::SubmissionsPending() const {
+  uint32_t sq_head = Index(sq, kHeadOffset)->load(std::memory_order_acquire);
+  uint32_t sq_tail = Index(sq, kTailOffset)->load(std::memory_order_acquire);
+  uint32_t cq_head = Index(cq, kHeadOffset)->load(std::memory_order_acquire);
+  uint32_t cq_tail = Index(cq, kTailOffset)->load(std::memory_order_acquire);
+  return sq_head != sq_tail && cq_tail - cq_head < entries;
+}
+
+/*
+ * `notify()`: has a worker run all the submissions there are by the time it
+ * gets to them. Does nothing if one is on it already; submissions that it
+ * misses get picked up once it's done (see `Finish()`).
+ */
+
+Value CallRing::Notify(const Napi::CallbackInfo& args) {
+  CallRing* ring = static_cast<CallRing*>(args.Data());
+  if (!ring->queued) {
+    ring->queued = true;
+    ring->refs++;
+    ring->instance->Pool()->Queue(&ring->req, Drain, Finish, ring->priority);
+  }
+  return args.Env().Undefined();
+}
+
+/*
+ * Called on the thread pool: runs submissions until the submission ring is
+ * empty or the completion ring is full. Both indices get published after
+ * every call, so that JS-land can reap completions (and submit more) while
+ * this is still going.
+ *
+ * A submission is the function's index and a tag (both uint32), followed by
+ * the arguments in their native representation, in 8-byte slots.
+ */
+
+void CallRing::Drain(uv_work_t* req) {
+  CallRing* ring = static_cast<CallRing*>(req->data);
+  std::atomic<uint32_t>* sq_head = Index(ring->sq, kHeadOffset);
+  std::atomic<uint32_t>* sq_tail = Index(ring->sq, kTailOffset);
+  std::atomic<uint32_t>* cq_head = Index(ring->cq, kHeadOffset);
+  std::atomic<uint32_t>* cq_tail = Index(ring->cq, kTailOffset);
+  uint32_t mask = ring->entries - 1;
+
+  // this is the only thread writing these two
+  uint32_t head = sq_head->load(std::memory_order_relaxed);
+  uint32_t tail = cq_tail->load(std::memory_order_relaxed);
+
+  while (head != sq_tail->load(std::memory_order_acquire) &&
+         tail - cq_head->load(std::memory_order_acquire) < ring->entries) {
+    uint8_t* entry =
+        ring->sq + kEntriesOffset + (head & mask) * ring->entry_size;
+    uint32_t index;
+    uint32_t tag;
+    memcpy(&index, entry, sizeof(index));
+    memcpy(&tag, entry + 4, sizeof(tag));
+
+    int32_t err = 0;
+    uint64_t result = 0;
+    if (index >= ring->plans.size()) {
+      err = EINVAL;
+    } else {
+      CallPlan* plan = ring->plans[index];
+      void** avalue = ring->avalue.data();
+      for (size_t n = 0; n < plan->kinds.size(); n++)
+        avalue[n] = entry + 8 + 8 * n;
+
+      uint64_t ints[kMaxThunkInts];
+      double doubles[kMaxThunkDoubles];
+      plan->LoadRegisters(avalue, ints, doubles);
+      int errnum = plan->Execute(&result, avalue, ints, doubles);
+      if (ResultIsError(plan->error_options.policy, plan->rkind, &result))
+        err = errnum != 0 ? errnum : -1;
+      NarrowResult(plan->rkind, &result);
+    }
+
+    uint8_t* completion =
+        ring->cq + kEntriesOffset + (tail & mask) * kCompletionSize;
+    memset(completion, 0, kCompletionSize);
+    memcpy(completion, &tag, sizeof(tag));
+    memcpy(completion + 4, &index, sizeof(index));
+    memcpy(completion + 8, &err, sizeof(err));
+    memcpy(completion + 16, &result, sizeof(result));
+
+    cq_tail->store(++tail, std::memory_order_release);
+    sq_head->store(++head, std::memory_order_release);
+  }
+}
+
+/*
+ * Called on the loop thread once `Drain()` is done: lets JS-land know, then
+ * goes for the submissions that came in too late for the worker, if any.
+ */
+
+void CallRing::Finish(uv_work_t* req, int status) {
+  CallRing* ring = static_cast<CallRing*>(req->data);
+  Env env = ring->instance->env;
+  HandleScope scope(env);
+  ring->queued = false;
+
+  if (!ring->on_completion.IsEmpty()) {
+    try {
+      ring->on_completion.Value().MakeCallback(env.Global(), {});
+    } catch (...) {
+      Release(env, ring);
+      throw;
+    }
+  }
+
+  // unless the callback did so already, by calling `notify()`
+  if (!ring->queued && ring->SubmissionsPending()) {
+    // hands its reference on to the next round
+    ring->queued = true;
+    ring->instance->Pool()->Queue(&ring->req, Drain, Finish, ring->priority);
+    return;
+  }
+  Release(env, ring);
+}
+
+}  // namespace FFI
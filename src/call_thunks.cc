@@ -0,0 +1,190 @@
+#include <string.h>
+#include "ffi.h"
+
+namespace FFI {
+
+/*
+ * Direct-call thunks for CallPlans whose arguments are all scalars.
+ *
+ * On x86-64 System V and AArch64 integer (and pointer) arguments and floating
+ * point arguments are assigned to their own register files, in order, and
+ * independently of each other. As long as every argument fits into a
+ * register, `f(int, double, int)` is called exactly like
+ * `f(int, int, double)`, so one thunk per (number of integer args, number of
+ * floating point args, return class) triple can call any function with such a
+ * signature using the native calling convention, without `ffi_call()`.
+ *
+ * `float` values travel in the low 32 bits of a floating point register, so
+ * they are stored in the first 4 bytes of a `double` slot.
+ */
+
+#if (defined(__x86_64__) || defined(__aarch64__)) && !defined(_WIN32) && \
+    !defined(__ILP32__)
+#define FFI_HAS_CALL_THUNKS 1
+#endif
+
+namespace {
+
+template <size_t... I>
+struct Indices {};
+
+template <size_t N, size_t... I>
+struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct MakeIndices<0, I...> {
+  typedef Indices<I...> type;
+};
+
+template <typename T, size_t>
+using Repeat = T;
+
+template <typename R>
+struct ResultStore {
+  template <typename Fn, typename... Args>
+  static void Call(void* rvalue, Fn fn, Args... args) {
+    R ret = fn(args...);
+    memcpy(rvalue, &ret, sizeof(ret));
+  }
+};
+
+template <>
+struct ResultStore<void> {
+  template <typename Fn, typename... Args>
+  static void Call(void* rvalue, Fn fn, Args... args) {
+    fn(args...);
+  }
+};
+
+template <typename R, size_t... II, size_t... DI>
+void ThunkImpl(void* fn, const uint64_t* ints, const double* doubles,
+               void* rvalue, Indices<II...>, Indices<DI...>) {
+  typedef R (*Fn)(Repeat<uint64_t, II>..., Repeat<double, DI>...);
+  ResultStore<R>::Call(rvalue, reinterpret_cast<Fn>(fn),
+                       ints[II]..., doubles[DI]...);
+}
+
+template <typename R, size_t NI, size_t ND>
+void Thunk(void* fn, const uint64_t* ints, const double* doubles,
+           void* rvalue) {
+  ThunkImpl<R>(fn, ints, doubles, rvalue,
+               typename MakeIndices<NI>::type(),
+               typename MakeIndices<ND>::type());
+}
+
+typedef MakeIndices<kMaxThunkInts + 1>::type IntCounts;
+typedef MakeIndices<kMaxThunkDoubles + 1>::type DoubleCounts;
+
+template <typename R, size_t NI, size_t... ND>
+CallThunk SelectByDoubles(size_t nd, Indices<ND...>) {
+  static const CallThunk thunks[] = { &Thunk<R, NI, ND>... };
+  return thunks[nd];
+}
+
+template <typename R, size_t... NI>
+CallThunk Select(size_t ni, size_t nd, Indices<NI...>) {
+  typedef CallThunk (*RowSelector)(size_t, DoubleCounts);
+  static const RowSelector rows[] = { &SelectByDoubles<R, NI>... };
+  return rows[ni](nd, DoubleCounts());
+}
+
+}  // anonymous namespace
+
+/*
+ * Returns the thunk that can call a function with the given cif, or nullptr
+ * if it has to go through `ffi_call()`. On success, `slots` receives the
+ * register slot of every argument.
+ */
+
+CallThunk FindCallThunk(ffi_cif* cif,
+                        bool variadic,
+                        ValueKind rkind,
+                        const std::vector<ValueKind>& kinds,
+                        std::vector<ThunkSlot>* slots) {
+#ifdef FFI_HAS_CALL_THUNKS
+  if (variadic || cif->abi != FFI_DEFAULT_ABI)
+    return nullptr;
+
+  std::vector<ThunkSlot> ret;
+  size_t ni = 0;
+  size_t nd = 0;
+  for (ValueKind kind : kinds) {
+    ThunkSlot slot;
+    slot.fp = kind == ValueKind::kFloat || kind == ValueKind::kDouble;
+    slot.index = static_cast<uint8_t>(slot.fp ? nd++ : ni++);
+    ret.push_back(slot);
+  }
+  if (ni > kMaxThunkInts || nd > kMaxThunkDoubles)
+    return nullptr;
+
+  CallThunk thunk;
+  switch (rkind) {
+    case ValueKind::kVoid:
+      thunk = Select<void>(ni, nd, IntCounts());
+      break;
+    case ValueKind::kFloat:
+    case ValueKind::kDouble:
+      thunk = Select<double>(ni, nd, IntCounts());
+      break;
+    default:
+      thunk = Select<uint64_t>(ni, nd, IntCounts());
+      break;
+  }
+  slots->swap(ret);
+  return thunk;
+#else
+  return nullptr;
+#endif
+}
+
+/*
+ * Sign- or zero-extends an integer value of the given kind, stored with its
+ * actual width at the start of `slot`, to the full 64-bit register value,
+ * which is what compilers expect callers to pass.
+ */
+
+void WidenInteger(ValueKind kind, uint64_t* slot) {
+  switch (kind) {
+    case ValueKind::kInt8: {
+      int8_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = static_cast<uint64_t>(static_cast<int64_t>(val));
+      break;
+    }
+    case ValueKind::kUint8:
+    case ValueKind::kBool: {
+      uint8_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = val;
+      break;
+    }
+    case ValueKind::kInt16: {
+      int16_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = static_cast<uint64_t>(static_cast<int64_t>(val));
+      break;
+    }
+    case ValueKind::kUint16: {
+      uint16_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = val;
+      break;
+    }
+    case ValueKind::kInt32: {
+      int32_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = static_cast<uint64_t>(static_cast<int64_t>(val));
+      break;
+    }
+    case ValueKind::kUint32: {
+      uint32_t val;
+      memcpy(&val, slot, sizeof(val));
+      *slot = val;
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+}  // namespace FFI
@@ -15,9 +15,13 @@ namespace FFI {
 
 void closure_pointer_cb(Env env, char* data, callback_info* hint) {
   callback_info* info = static_cast<callback_info*>(hint);
-  // now we can free the closure data
-  info->~callback_info();
-  ffi_closure_free(info);
+  // nonblocking invokations that are still pending free it once they've run
+  if (info->detached.load() > 0) {
+    info->collected = true;
+    return;
+  }
+  // now the closure can go to the next callback of the same signature
+  CallbackInfo::FreeClosure(info);
 }
 
 /*
@@ -41,6 +45,8 @@ void CallbackInfo::DispatchToV8(callback_info* info, void* retval, void** parame
       } else {
         throw Error::New(env, errorMessage);
       }
+    } else if (!info->kinds.empty()) {
+      CallDecoded(info, retval, parameters, dispatched);
     } else {
       // invoke the registered callback function
       Value e = info->function.MakeCallback(Object::New(env), {
@@ -60,19 +66,102 @@ void CallbackInfo::DispatchToV8(callback_info* info, void* retval, void** parame
   }
 }
 
+/*
+ * Invokes the JS function itself with the arguments decoded from `parameters`,
+ * and encodes its return value into `retval`, for callbacks whose types all
+ * have a ValueKind. That spares the two Buffers around `retval` and
+ * `parameters` along with a Buffer per argument that the JS-land wrapper goes
+ * through, which is most of the cost of a qsort() comparator.
+ */
+
+void CallbackInfo::CallDecoded(callback_info* info, void* retval, void** parameters, bool dispatched) {
+  Env env = info->instance_data->env;
+  const size_t argc = info->kinds.size() - 1;
+
+  napi_value inline_args[8];
+  std::vector<napi_value> heap_args;
+  napi_value* argv = inline_args;
+  if (argc > 8) {
+    heap_args.resize(argc);
+    argv = heap_args.data();
+  }
+
+  try {
+    for (size_t i = 0; i < argc; i++) {
+      ValueKind kind = info->kinds[i + 1];
+      if (kind == ValueKind::kPointer) {
+        // the same "type" and length as `ref.get()` gives them
+        TypedArray buf = WrapPointer(env, *static_cast<char**>(parameters[i]),
+                                     info->pointer_sizes[i]);
+        Value type = info->pointer_types.Value().Get(static_cast<uint32_t>(i));
+        if (!type.IsUndefined()) buf["type"] = type;
+        argv[i] = buf;
+      } else {
+        argv[i] = ReadValue(env, kind, parameters[i]);
+      }
+    }
+
+    // on the loop thread, the JS function is called from JS-land already
+    Value result = dispatched
+        ? info->function.MakeCallback(env.Global(), argc, argv)
+        : info->function.Call(env.Global(), argc, argv);
+
+    ValueKind rkind = info->kinds[0];
+    if (rkind != ValueKind::kVoid) {
+      try {
+        WriteValue(env, rkind, result, retval, nullptr);
+      } catch (Error& e) {
+        e.Set("message", String::New(env, "error setting return value - " +
+                                          e.Message()));
+        throw;
+      }
+      WidenResult(rkind, retval);
+    }
+  } catch (Error& e) {
+    if (!dispatched) throw;
+    info->errorFunction.Call({ e.Value() });
+  }
+}
+
+/*
+ * Runs the callbacks that were invoked on other threads, on the loop thread.
+ * It takes all the pending ones off the stack at once, and runs them in the
+ * order they came in without holding any lock, so the threads invoking more
+ * callbacks in the meantime never have to wait for JS-land.
+ */
+
 void CallbackInfo::WatcherCallback(uv_async_t* w) {
   InstanceData* data = static_cast<InstanceData*>(w->data);
-  uv_mutex_lock(&data->mutex);
 
-  while (!data->queue.empty()) {
-    ThreadedCallbackInvokation* inv = data->queue.front();
-    data->queue.pop();
+  ThreadedCallbackInvokation* pending;
+  while ((pending = data->callbacks.exchange(
+              nullptr, std::memory_order_acquire)) != nullptr) {
+    // the stack has the newest one on top
+    ThreadedCallbackInvokation* inv = nullptr;
+    while (pending != nullptr) {
+      ThreadedCallbackInvokation* next = pending->m_next;
+      pending->m_next = inv;
+      inv = pending;
+      pending = next;
+    }
 
-    DispatchToV8(inv->m_cbinfo, inv->m_retval, inv->m_parameters, true);
-    inv->SignalDoneExecuting();
+    while (inv != nullptr) {
+      // the invoking thread reuses it once it's signalled, unless nobody is
+      // waiting for it
+      ThreadedCallbackInvokation* next = inv->m_next;
+      if (inv->m_detached) {
+        std::unique_ptr<ThreadedCallbackInvokation> owned(inv);
+        callback_info* info = inv->m_cbinfo;
+        DispatchToV8(info, inv->m_retval, inv->m_parameters, true);
+        if (--info->detached == 0 && info->collected)
+          FreeClosure(info);
+      } else {
+        DispatchToV8(inv->m_cbinfo, inv->m_retval, inv->m_parameters, true);
+        inv->SignalDoneExecuting();
+      }
+      inv = next;
+    }
   }
-
-  uv_mutex_unlock(&data->mutex);
 }
 
 /*
@@ -83,9 +172,10 @@ void CallbackInfo::WatcherCallback(uv_async_t* w) {
 Value CallbackInfo::Callback(const Napi::CallbackInfo& args) {
   Env env = args.Env();
 
-  if (args.Length() != 5 || !args[0].IsBuffer() ||
+  if (args.Length() < 5 || !args[0].IsBuffer() ||
       !args[3].IsFunction() || !args[4].IsFunction()) {
-    throw Error::New(env, "Signature: Buffer, int, int, Function, Function");
+    throw Error::New(env, "Signature: Buffer, int, int, Function, Function"
+                          "[, Boolean, Array, Array, Array, Array]");
   }
 
   // Args: cif pointer, JS function
@@ -95,48 +185,175 @@ Value CallbackInfo::Callback(const Napi::CallbackInfo& args) {
   Function errorReportCallback = args[3].As<Function>();
   Function callback = args[4].As<Function>();
 
-  callback_info* cbInfo;
-  ffi_status status;
-  void* code;
-
-  void* storage = ffi_closure_alloc(sizeof(callback_info), &code);
-  if (storage == nullptr) {
-    throw Error::New(env, "ffi_closure_alloc() Returned Error");
+  // args[5]: nonblocking, args[6]: the indices of the C string arguments
+  // to copy for it
+  bool nonblocking = args[5].ToBoolean();
+  if (nonblocking && cif->rtype->type != FFI_TYPE_VOID)
+    throw TypeError::New(env, "nonblocking callbacks must return void");
+
+  // args[7]: the ValueKinds of the return value and the arguments, for the JS
+  // function to get called with the decoded arguments (see `CallDecoded()`),
+  // args[8] and args[9]: the "type"s and lengths of the pointer arguments
+  if (args[7].IsArray() &&
+      (args[7].As<Array>().Length() != cif->nargs + 1 ||
+       !args[8].IsArray() || !args[9].IsArray())) {
+    throw RangeError::New(env, "Callback(): kinds do not match the cif");
   }
 
-  cbInfo = new(storage) callback_info();
+  callback_info* cbInfo = NewClosure(env, cif, args[0].As<Object>());
 
   cbInfo->resultSize = resultSize;
   cbInfo->argc = argc;
   cbInfo->errorFunction = Reference<Function>::New(errorReportCallback, 1);
   cbInfo->function = Reference<Function>::New(callback, 1);
-  cbInfo->instance_data = InstanceData::Get(env);
 
-  // store a reference to the callback function pointer
-  // (not sure if this is actually needed...)
-  cbInfo->code = code;
+  cbInfo->nonblocking = nonblocking;
+  if (nonblocking && args[6].IsArray()) {
+    Array strings = args[6].As<Array>();
+    cbInfo->copy_strings.resize(cif->nargs);
+    for (uint32_t i = 0; i < strings.Length(); i++) {
+      uint32_t index = strings.Get(i).ToNumber().Uint32Value();
+      if (index < cif->nargs)
+        cbInfo->copy_strings[index] = true;
+    }
+  }
+
+  if (args[7].IsArray()) {
+    Array kinds = args[7].As<Array>();
+    Array sizes = args[9].As<Array>();
+    for (uint32_t i = 0; i < kinds.Length(); i++) {
+      cbInfo->kinds.push_back(
+          static_cast<ValueKind>(kinds.Get(i).ToNumber().Uint32Value()));
+    }
+    for (uint32_t i = 0; i < cif->nargs; i++)
+      cbInfo->pointer_sizes.push_back(sizes.Get(i).ToNumber().Uint32Value());
+    cbInfo->pointer_types = Persistent(args[8].As<Object>());
+  }
+
+  TypedArray ret = WrapPointer(env, cbInfo->code, sizeof(void*));
+  ret.ArrayBuffer().
+      AddFinalizer(closure_pointer_cb, static_cast<char*>(cbInfo->code), cbInfo);
+  return ret;
+}
+
+/*
+ * Returns a closure prepared for `cif`, which only needs its JS functions
+ * bound: one of a callback of the same signature that has been collected if
+ * there is any, or a new one. The closure's user data is the struct itself,
+ * so a reused one doesn't have to be prepared again.
+ *
+ * The kept closures only hold on to their cif's Buffer weakly (cif.js lets
+ * unused cifs go), so those of a cif that's gone are dropped instead, even if
+ * `cif_buf` happens to live at the same address.
+ */
+
+callback_info* CallbackInfo::NewClosure(Env env, ffi_cif* cif, Object cif_buf) {
+  InstanceData* data = InstanceData::Get(env);
+  auto free = data->free_closures.find(cif);
+  if (free != data->free_closures.end() && !free->second.empty()) {
+    Object kept = free->second.back()->cif_buf.Value();
+    if (!kept.IsEmpty() && kept.StrictEquals(cif_buf)) {
+      callback_info* info = free->second.back();
+      free->second.pop_back();
+      return info;
+    }
+    DropClosures(&free->second);
+  }
+
+  void* code;
+  void* storage = ffi_closure_alloc(sizeof(callback_info), &code);
+  if (storage == nullptr) {
+    throw Error::New(env, "ffi_closure_alloc() Returned Error");
+  }
 
-  //CallbackInfo *self = new CallbackInfo(callback, closure, code, argc);
+  callback_info* info = new(storage) callback_info();
+  info->instance_data = data;
+  info->cif_buf = Reference<Object>::New(cif_buf, 0);
+  // store a reference to the callback function pointer
+  info->code = code;
 
-  status = ffi_prep_closure_loc(
-    &cbInfo->closure,
+  ffi_status status = ffi_prep_closure_loc(
+    &info->closure,
     cif,
     Invoke,
-    static_cast<void*>(cbInfo),
+    static_cast<void*>(info),
     code
   );
 
   if (status != FFI_OK) {
-    ffi_closure_free(cbInfo);
+    info->~callback_info();
+    ffi_closure_free(info);
     Error e = Error::New(env, "ffi_prep_closure() Returned Error");
     e.Set("status", Number::New(env, status));
     throw e;
   }
+  return info;
+}
 
-  TypedArray ret = WrapPointer(env, code, sizeof(void*));
-  ret.ArrayBuffer().
-      AddFinalizer(closure_pointer_cb, static_cast<char*>(code), cbInfo);
-  return ret;
+/*
+ * Unbinds the JS functions of a closure that nothing is going to invoke
+ * anymore, and keeps it for the next callback of the same signature, up to
+ * `kMaxFreeClosures` of them per signature. Called on the loop thread.
+ */
+
+void CallbackInfo::FreeClosure(callback_info* info) {
+  std::vector<callback_info*>& free =
+      info->instance_data->free_closures[info->closure.cif];
+  if (free.size() >= kMaxFreeClosures) {
+    info->~callback_info();
+    ffi_closure_free(info);
+    return;
+  }
+
+  info->function.Reset();
+  info->errorFunction.Reset();
+  info->pointer_types.Reset();
+  info->nonblocking = false;
+  info->copy_strings.clear();
+  info->collected = false;
+  info->kinds.clear();
+  info->pointer_sizes.clear();
+  free.push_back(info);
+}
+
+void CallbackInfo::DropClosures(std::vector<callback_info*>* closures) {
+  for (callback_info* info : *closures) {
+    info->~callback_info();
+    ffi_closure_free(info);
+  }
+  closures->clear();
+}
+
+/*
+ * Frees the kept closures of the cifs that have been collected. Called by
+ * cif.js whenever it lets go of one.
+ */
+
+Value CallbackInfo::SweepClosures(const Napi::CallbackInfo& args) {
+  InstanceData* data = InstanceData::Get(args.Env());
+  for (auto it = data->free_closures.begin();
+       it != data->free_closures.end();) {
+    if (it->second.empty() || it->second.back()->cif_buf.Value().IsEmpty()) {
+      DropClosures(&it->second);
+      it = data->free_closures.erase(it);
+    } else {
+      ++it;
+    }
+  }
+  return args.Env().Undefined();
+}
+
+/*
+ * Pushes an invokation onto the stack of pending callbacks, from any thread.
+ */
+
+static void Push(InstanceData* data, ThreadedCallbackInvokation* inv) {
+  ThreadedCallbackInvokation* head =
+      data->callbacks.load(std::memory_order_relaxed);
+  do {
+    inv->m_next = head;
+  } while (!data->callbacks.compare_exchange_weak(
+      head, inv, std::memory_order_release, std::memory_order_relaxed));
 }
 
 /*
@@ -158,20 +375,24 @@ void CallbackInfo::Invoke(ffi_cif* cif,
   if (uv_thread_equal(&self_thread, &data->thread)) {
 #endif
     DispatchToV8(info, retval, parameters);
+  } else if (info->nonblocking) {
+    // nothing to wait for: hand a copy of the arguments over and return.
+    // Unlike the blocking ones, these don't keep the event loop alive.
+    info->detached++;
+    Push(data, ThreadedCallbackInvokation::Copy(info, cif, parameters));
+    uv_async_send(&data->async);
   } else {
     // hold the event loop open while this is executing
     // TODO: REF()ING FROM A DIFFERENT IS AN INHERENT RACE CONDITION AND THIS
     // CODE SHOULD NEVER HAVE BEEN WRITTEN
     uv_ref(reinterpret_cast<uv_handle_t*>(&data->async));
 
-    // create a temporary storage area for our invokation parameters
-    std::unique_ptr<ThreadedCallbackInvokation> inv (
-        new ThreadedCallbackInvokation(info, retval, parameters));
+    // this thread's storage area for our invokation parameters
+    ThreadedCallbackInvokation* inv =
+        ThreadedCallbackInvokation::ForThisThread(info, retval, parameters);
 
-    // push it to the queue -- threadsafe
-    uv_mutex_lock(&data->mutex);
-    data->queue.push(inv.get());
-    uv_mutex_unlock(&data->mutex);
+    // push it onto the stack of pending callbacks -- lock-free
+    Push(data, inv);
 
     // send a message to our main thread to wake up the WatchCallback loop
     uv_async_send(&data->async);
@@ -201,7 +422,6 @@ Function CallbackInfo::Initialize(Env env) {
   napi_get_uv_event_loop(env, &loop);
   uv_async_init(loop, &instance_data->async, CallbackInfo::WatcherCallback);
   instance_data->async.data = instance_data;
-  uv_mutex_init(&instance_data->mutex);
 
   // allow the event loop to exit while this is running
   uv_unref(reinterpret_cast<uv_handle_t*>(&instance_data->async));
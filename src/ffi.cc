@@ -13,12 +13,340 @@ InstanceData* InstanceData::Get(Env env) {
   return static_cast<InstanceData*>(d);
 }
 
+/*
+ * Request objects for asynchronous calls are kept around for reuse, so that
+ * (along with their argument storage, see `CallPlan::Async()`) they don't get
+ * allocated for every call.
+ */
+
+static const size_t kMaxFreeAsyncCalls = 256;
+
+AsyncCallParams* InstanceData::NewAsyncCall() {
+  if (free_async_calls.empty())
+    return new AsyncCallParams(env);
+  AsyncCallParams* p = free_async_calls.back();
+  free_async_calls.pop_back();
+  return p;
+}
+
+void InstanceData::FreeAsyncCall(AsyncCallParams* p) {
+  // the listener points at `p`, so it can't outlive it
+  p->Detach(env);
+  for (AsyncLimits*& limits : p->limits) {
+    if (limits != nullptr)
+      limits->Completed(env, !p->waiting);
+    limits = nullptr;
+  }
+  p->waiting = false;
+  if (free_async_calls.size() >= kMaxFreeAsyncCalls) {
+    delete p;
+    return;
+  }
+  p->callback.Reset();
+  p->err.clear();
+  p->error_options = ErrorOptions();
+  p->errnum = 0;
+  p->plan = nullptr;
+  p->chain = nullptr;
+  p->state = AsyncState::kQueued;
+  p->deadline = 0;
+  p->queue = nullptr;
+  // only left over by calls that never got queued
+  if (p->context != nullptr)
+    napi_async_destroy(env, p->context);
+  p->context = nullptr;
+  p->deferred = nullptr;
+  free_async_calls.push_back(p);
+}
+
+/*
+ * Parses the name of a Priority, "interactive", "normal" or "bulk". Returns
+ * `fallback` when it's undefined.
+ */
+
+Priority ParsePriority(Env env, Value name, Priority fallback) {
+  if (name.IsUndefined())
+    return fallback;
+  std::string str = name.IsString() ? name.As<String>().Utf8Value() : "";
+  if (str == "interactive")
+    return Priority::kInteractive;
+  if (str == "normal")
+    return Priority::kNormal;
+  if (str == "bulk")
+    return Priority::kBulk;
+  throw TypeError::New(env,
+      "priority must be one of: interactive, normal, bulk");
+}
+
+/*
+ * Applies the options of a single async call, passed as an Object after its
+ * callback:
+ *
+ *  - `signal`, an AbortSignal (or anything with `aborted` and
+ *    `addEventListener()`), withdraws the call while it is still queued
+ *  - `timeout`, in milliseconds, drops the call if it hasn't started by then;
+ *    the function's `timeout` option is the default, 0 for none
+ *  - `priority`, overrides the function's (see `ParsePriority()`)
+ *
+ * `queue_` is the pool the call is about to be queued on, null for libuv's.
+ */
+
+void AsyncCallParams::SetCallOptions(Env env, Value options, uint32_t timeout,
+                                     Priority priority_, WorkerPool* queue_) {
+  state = AsyncState::kQueued;
+  queue = queue_;
+  priority = priority_;
+  if (!options.IsUndefined() && !options.IsObject())
+    throw TypeError::New(env, "Expected an Object of call options");
+
+  Value signal_ = env.Undefined();
+  if (options.IsObject()) {
+    Object opts = options.As<Object>();
+    Value t = opts.Get("timeout");
+    if (!t.IsUndefined()) {
+      if (!t.IsNumber() || t.As<Number>().DoubleValue() < 0)
+        throw TypeError::New(env, "timeout must be a non-negative Number");
+      timeout = t.As<Number>().Uint32Value();
+    }
+    priority = ParsePriority(env, opts.Get("priority"), priority);
+    signal_ = opts.Get("signal");
+  }
+  deadline = timeout > 0 ? uv_hrtime() + timeout * UINT64_C(1000000) : 0;
+
+  if (signal_.IsUndefined() || signal_.IsNull())
+    return;
+  if (!signal_.IsObject() ||
+      !signal_.As<Object>().Get("addEventListener").IsFunction() ||
+      !signal_.As<Object>().Get("removeEventListener").IsFunction())
+    throw TypeError::New(env, "signal must be an AbortSignal");
+  Object s = signal_.As<Object>();
+  signal = Reference<Object>::New(s, 1);
+  if (s.Get("aborted").ToBoolean()) {
+    // still goes through the queue, so the callback is never called early
+    state = AsyncState::kAborted;
+    return;
+  }
+  // the signal may hold on to the listener after the call is done with (and
+  // this request reused), so it gets to the call through a token that
+  // `Detach()` clears
+  abort_token = new AsyncCallParams*(this);
+  Function listener = Function::New(env, OnAbort, "onabort", abort_token);
+  listener.AddFinalizer([](Env, AsyncCallParams** token) {
+    delete token;
+  }, abort_token);
+  abort_listener = Reference<Function>::New(listener, 1);
+  s.Get("addEventListener").As<Function>().Call(s, {
+    String::New(env, "abort"), listener
+  });
+}
+
+/*
+ * Called on the loop thread when the call's AbortSignal fires. A call that is
+ * still queued gets handed back right away, rather than when a worker gets to
+ * it; one that already started can't be stopped anymore.
+ */
+
+Value AsyncCallParams::OnAbort(const Napi::CallbackInfo& info) {
+  AsyncCallParams* p = *static_cast<AsyncCallParams**>(info.Data());
+  if (p == nullptr)
+    return info.Env().Undefined();
+  AsyncState expected = AsyncState::kQueued;
+  if (p->state.compare_exchange_strong(expected, AsyncState::kAborted)) {
+    if (p->queue != nullptr)
+      p->queue->Cancel(&p->req);
+    else
+      uv_cancel(reinterpret_cast<uv_req_t*>(&p->req));
+  }
+  return info.Env().Undefined();
+}
+
+/*
+ * Called on the thread pool right before the foreign call. Returns false,
+ * and the call must not be made, when it has been aborted or its deadline
+ * has passed.
+ */
+
+bool AsyncCallParams::Start() {
+  uint64_t now = uv_hrtime();
+  AsyncState next = deadline != 0 && now >= deadline ?
+      AsyncState::kExpired : AsyncState::kRunning;
+  AsyncState expected = AsyncState::kQueued;
+  bool run = state.compare_exchange_strong(expected, next) &&
+             next == AsyncState::kRunning;
+
+  waiting = false;
+  started_at = now;
+  for (AsyncLimits* l : limits) {
+    if (l != nullptr)
+      l->Started(now - queued_at, run);
+  }
+  return run;
+}
+
+/*
+ * Called on the thread pool right after the foreign call, if `Start()`
+ * returned true.
+ */
+
+void AsyncCallParams::Stop() {
+  uint64_t run = uv_hrtime() - started_at;
+  for (AsyncLimits* l : limits) {
+    if (l != nullptr)
+      l->Stopped(run);
+  }
+}
+
+/*
+ * Counts the call against the global caps and those of its function, if
+ * any, right before it gets queued (see async_limits.cc).
+ */
+
+void AsyncCallParams::Submit(InstanceData* instance, AsyncLimits* own) {
+  limits[0] = instance->Limits();
+  limits[1] = own;
+  queued_at = uv_hrtime();
+  waiting = true;
+  for (AsyncLimits* l : limits) {
+    if (l != nullptr)
+      l->Submitted();
+  }
+}
+
+bool AsyncCallParams::Dropped() const {
+  AsyncState current = state.load();
+  return current == AsyncState::kAborted || current == AsyncState::kExpired;
+}
+
+/*
+ * The Error a dropped call's callback gets: an "AbortError" like the ones of
+ * Node's own APIs, with the signal's reason as its `cause`, or one with the
+ * "ERR_FFI_DEADLINE_EXCEEDED" code.
+ */
+
+Error AsyncCallParams::DroppedError(Env env) {
+  if (state.load() == AsyncState::kExpired) {
+    Error e = Error::New(env, "The call's deadline passed before it started");
+    e.Set("code", String::New(env, "ERR_FFI_DEADLINE_EXCEEDED"));
+    return e;
+  }
+  Error e = Error::New(env, "The operation was aborted");
+  e.Set("name", String::New(env, "AbortError"));
+  e.Set("code", String::New(env, "ABORT_ERR"));
+  if (!signal.IsEmpty()) {
+    Value reason = signal.Value().Get("reason");
+    if (!reason.IsUndefined())
+      e.Set("cause", reason);
+  }
+  return e;
+}
+
+/*
+ * Stops listening to the call's AbortSignal, once the call is done.
+ */
+
+void AsyncCallParams::Detach(Env env) {
+  if (!abort_listener.IsEmpty()) {
+    *abort_token = nullptr;
+    abort_token = nullptr;
+    Object s = signal.Value();
+    Value remove = s.Get("removeEventListener");
+    if (remove.IsFunction()) {
+      remove.As<Function>().Call(s, {
+        String::New(env, "abort"), abort_listener.Value()
+      });
+    }
+    abort_listener.Reset();
+  }
+  signal.Reset();
+}
+
+/*
+ * Captures the async context the call is being made in, for `async_hooks`
+ * and `AsyncLocalStorage`: the callback, or the continuations of the promise,
+ * run in that context once the call is done. With `promise`, the call gets a
+ * promise instead of a callback, which this returns.
+ */
+
+Value AsyncCallParams::Track(Env env, bool promise) {
+  if (napi_async_init(env, nullptr, String::New(env, "FFICALL"),
+                      &context) != napi_ok)
+    throw Error::New(env);
+  if (!promise)
+    return env.Undefined();
+
+  napi_value result;
+  if (napi_create_promise(env, &deferred, &result) != napi_ok)
+    throw Error::New(env);
+  return Value(env, result);
+}
+
+/*
+ * Called on the loop thread once the call is done: frees the request, then
+ * hands `argv`, `(err, ...results)`, to the callback, or settles the call's
+ * promise with them, in the context the call was made in.
+ */
+
+void AsyncCallParams::Deliver(Env env, Value callback,
+                              const std::vector<napi_value>& argv) {
+  // keep the request for the next call before the callback gets a chance to
+  // throw
+  napi_async_context context_ = context;
+  napi_deferred deferred_ = deferred;
+  context = nullptr;
+  deferred = nullptr;
+  InstanceData::Get(env)->FreeAsyncCall(this);
+
+  // however the callback returns
+  struct ContextScope {
+    napi_env env;
+    napi_async_context context;
+    ~ContextScope() { if (context != nullptr) napi_async_destroy(env, context); }
+  } context_scope = { env, context_ };
+
+  if (deferred_ == nullptr) {
+    callback.As<Function>().MakeCallback(env.Global(), argv, context_);
+    return;
+  }
+
+  Value err(env, argv[0]);
+  Value value = argv.size() > 1 ? Value(env, argv[1]) : env.Undefined();
+  if (context_ == nullptr) {
+    if (err.IsNull())
+      napi_resolve_deferred(env, deferred_, value);
+    else
+      napi_reject_deferred(env, deferred_, err);
+    return;
+  }
+  // so that the continuations see the call's context too
+  CallbackScope scope(env, context_);
+  if (err.IsNull())
+    napi_resolve_deferred(env, deferred_, value);
+  else
+    napi_reject_deferred(env, deferred_, err);
+}
+
+InstanceData::~InstanceData() {
+  for (AsyncCallParams* p : free_async_calls)
+    delete p;
+  // the environment may be gone by now, along with the references
+  for (auto& free : free_closures) {
+    for (callback_info* info : free.second) {
+      info->cif_buf.SuppressDestruct();
+      info->~callback_info();
+      ffi_closure_free(info);
+    }
+  }
+}
+
 void InstanceData::Dispose() {
+  for (auto& free : free_closures)
+    CallbackInfo::DropClosures(&free.second);
+  if (pool != nullptr) pool->Dispose();
+  for (auto& executor : executors)
+    executor.second->Dispose();
   if (async.type != UV_ASYNC) return;
   uv_close(reinterpret_cast<uv_handle_t*>(&async), [](uv_handle_t* handle) {
-    InstanceData* self = static_cast<InstanceData*>(handle->data);
-    uv_mutex_destroy(&self->mutex);
-    delete self;
+    delete static_cast<InstanceData*>(handle->data);
   });
 }
 
@@ -36,6 +364,50 @@ char* GetBufferDataImpl(Value val) {
 
 static int __ffi_errno() { return errno; }
 
+void ErrorOptions::Parse(Value flags, Value name_) {
+  uint32_t bits = flags.IsNumber() ? flags.ToNumber().Uint32Value() : 0;
+  capture_errno = (bits & 1) != 0;
+  policy = static_cast<ErrorPolicy>(bits >> 1);
+  name = name_.IsString() ? name_.As<String>().Utf8Value() : std::string();
+}
+
+/*
+ * Creates an Error that looks like the ones thrown by Node's own failed
+ * system calls: "ENOENT: no such file or directory, open", with `errno`,
+ * `code` and `syscall` properties.
+ */
+
+Error ErrnoError(Env env, int errnum, const std::string& name) {
+  std::string fname = name.empty() ? "foreign function" : name;
+  if (errnum == 0) {
+    Error e = Error::New(env, fname + "() failed");
+    e.Set("errno", Number::New(env, 0));
+    if (!name.empty()) e.Set("syscall", String::New(env, name));
+    return e;
+  }
+
+  std::string message = strerror(errnum);
+#ifndef WIN32
+  // libuv error codes are negated errno values on Unix-like systems
+  std::string code = uv_err_name(-errnum);
+  message = code + ": " + message;
+#endif
+  if (!name.empty())
+    message += ", " + name;
+
+  Error e = Error::New(env, message);
+  e.Set("errno", Number::New(env, errnum));
+#ifndef WIN32
+  e.Set("code", String::New(env, code));
+#endif
+  if (!name.empty()) e.Set("syscall", String::New(env, name));
+  return e;
+}
+
+static Value LastErrno(const Napi::CallbackInfo& args) {
+  return Number::New(args.Env(), InstanceData::Get(args.Env())->last_errno);
+}
+
 Object FFI::InitializeStaticFunctions(Env env) {
   Object o = Object::New(env);
 
@@ -59,7 +431,20 @@ void FFI::InitializeBindings(Env env, Object target) {
   target["ffi_prep_cif"] = Function::New(env, FFIPrepCif);
   target["ffi_prep_cif_var"] = Function::New(env, FFIPrepCifVar);
   target["ffi_call"] = Function::New(env, FFICall);
+  target["ffi_call_stub"] = Function::New(env, FFICallStub);
+  target["ffi_call_value"] = Function::New(env, FFICallValue);
   target["ffi_call_async"] = Function::New(env, FFICallAsync);
+  target["ffi_call_plan"] = Function::New(env, CallPlan::New);
+  target["ffi_call_chain"] = Function::New(env, CallChain::New);
+  target["ffi_call_ring"] = Function::New(env, CallRing::New);
+  target["ffi_last_errno"] = Function::New(env, LastErrno);
+  target["ffi_configure_pool"] = Function::New(env, WorkerPool::Configure);
+  target["ffi_async_limits"] = Function::New(env, AsyncLimits::New);
+  target["ffi_configure_async_limits"] =
+      Function::New(env, AsyncLimits::Configure);
+  target["ffi_async_limits_full"] = Function::New(env, AsyncLimits::Full);
+  target["ffi_async_stats"] = Function::New(env, AsyncLimits::Stats);
+  target["ffi_sweep_closures"] = Function::New(env, CallbackInfo::SweepClosures);
 
   // `ffi_status` enum values
   SET_ENUM_VALUE(FFI_OK);
@@ -160,6 +545,35 @@ void FFI::InitializeBindings(Env env, Object target) {
   ftmap["longlong"] = WrapPointer(env, &ffi_type_slong);
 
   target["FFI_TYPES"] = ftmap;
+
+  // the `ValueKind`s that CallPlan knows how to marshal natively
+  Object kinds = Object::New(env);
+  kinds["void"] = Number::New(env, static_cast<int>(ValueKind::kVoid));
+  kinds["int8"] = Number::New(env, static_cast<int>(ValueKind::kInt8));
+  kinds["uint8"] = Number::New(env, static_cast<int>(ValueKind::kUint8));
+  kinds["int16"] = Number::New(env, static_cast<int>(ValueKind::kInt16));
+  kinds["uint16"] = Number::New(env, static_cast<int>(ValueKind::kUint16));
+  kinds["int32"] = Number::New(env, static_cast<int>(ValueKind::kInt32));
+  kinds["uint32"] = Number::New(env, static_cast<int>(ValueKind::kUint32));
+  kinds["int64"] = Number::New(env, static_cast<int>(ValueKind::kInt64));
+  kinds["uint64"] = Number::New(env, static_cast<int>(ValueKind::kUint64));
+  kinds["float"] = Number::New(env, static_cast<int>(ValueKind::kFloat));
+  kinds["double"] = Number::New(env, static_cast<int>(ValueKind::kDouble));
+  kinds["bool"] = Number::New(env, static_cast<int>(ValueKind::kBool));
+  kinds["pointer"] = Number::New(env, static_cast<int>(ValueKind::kPointer));
+  kinds["string"] = Number::New(env, static_cast<int>(ValueKind::kCString));
+
+  target["VALUE_KINDS"] = kinds;
+
+  // the `ErrorPolicy`s, as used in the error flags
+  Object policies = Object::New(env);
+  policies["negative"] =
+      Number::New(env, static_cast<int>(ErrorPolicy::kNegative));
+  policies["nonzero"] =
+      Number::New(env, static_cast<int>(ErrorPolicy::kNonZero));
+  policies["zero"] = Number::New(env, static_cast<int>(ErrorPolicy::kZero));
+
+  target["ERROR_POLICIES"] = policies;
 }
 
 /*
@@ -238,6 +652,10 @@ Value FFI::FFIPrepCifVar(const Napi::CallbackInfo& args) {
  * args[1] - Buffer - the C function pointer to invoke
  * args[2] - Buffer - the `void *` buffer big enough to hold the return value
  * args[3] - Buffer - the `void **` array of pointers containing the arguments
+ * args[4] - Buffer - the cif's call stub (optional, see `FFICallStub()`)
+ * args[5] - Number - the error flags (optional, see ErrorOptions)
+ * args[6] - String - the function's name, for error messages
+ * args[7] - Number - the ValueKind of the return value, for the error policy
  */
 
 void FFI::FFICall(const Napi::CallbackInfo& args) {
@@ -251,8 +669,120 @@ void FFI::FFICall(const Napi::CallbackInfo& args) {
   char* fn = GetBufferData<char>(args[1]);
   char* res = GetBufferData<char>(args[2]);
   void** fnargs = GetBufferData<void*>(args[3]);
+  ErrorOptions error_options;
+  error_options.Parse(args[5], args[6]);
+
+  if (error_options.capture_errno)
+    errno = 0;
+
+  if (args[4].IsBuffer()) {
+    CallStub stub = reinterpret_cast<CallStub>(GetBufferData<char>(args[4]));
+    stub(FFI_FN(fn), static_cast<void*>(res), fnargs);
+  } else {
+    ffi_call(cif, FFI_FN(fn), static_cast<void*>(res), fnargs);
+  }
+
+  int errnum = error_options.capture_errno ? errno : 0;
+  if (env.IsExceptionPending())
+    return;
+  if (error_options.capture_errno)
+    InstanceData::Get(env)->last_errno = errnum;
 
-  ffi_call(cif, FFI_FN(fn), static_cast<void*>(res), fnargs);
+  ValueKind kind = static_cast<ValueKind>(args[7].ToNumber().Uint32Value());
+  if (ResultIsError(error_options.policy, kind, res))
+    throw ErrnoError(env, errnum, error_options.name);
+}
+
+/*
+ * Like `FFICall()`, but for return types with a ValueKind other than
+ * "pointer": the result is decoded natively and returned, so no result
+ * Buffer is needed.
+ *
+ * args[0] - Buffer - the `ffi_cif *`
+ * args[1] - Buffer - the C function pointer to invoke
+ * args[2] - Buffer - the `void **` array of pointers containing the arguments
+ * args[3] - Number - the ValueKind of the return value
+ * args[4] - Boolean - return 64-bit integers as BigInts
+ * args[5] - Buffer - the cif's call stub (optional)
+ * args[6] - Number - the error flags (optional, see ErrorOptions)
+ * args[7] - String - the function's name, for error messages
+ *
+ * returns the JS value of the result
+ */
+
+Value FFI::FFICallValue(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  if (!args[0].IsBuffer() || !args[1].IsBuffer() || !args[2].IsBuffer()) {
+    throw TypeError::New(env, "ffi_call_value() requires 3 Buffer arguments!");
+  }
+
+  ffi_cif* cif = GetBufferData<ffi_cif>(args[0]);
+  char* fn = GetBufferData<char>(args[1]);
+  void** fnargs = GetBufferData<void*>(args[2]);
+  ValueKind kind = static_cast<ValueKind>(args[3].ToNumber().Uint32Value());
+  if (kind == ValueKind::kPointer || cif->rtype->size > sizeof(uint64_t)) {
+    throw TypeError::New(env, "ffi_call_value() can't return this type");
+  }
+
+  // big enough for the widened `ffi_arg` as well
+  union {
+    ffi_arg arg;
+    uint64_t u64;
+    double d;
+    void* ptr;
+  } result;
+
+  ErrorOptions error_options;
+  error_options.Parse(args[6], args[7]);
+  if (error_options.capture_errno)
+    errno = 0;
+
+  if (args[5].IsBuffer()) {
+    CallStub stub = reinterpret_cast<CallStub>(GetBufferData<char>(args[5]));
+    stub(FFI_FN(fn), &result, fnargs);
+  } else {
+    ffi_call(cif, FFI_FN(fn), &result, fnargs);
+  }
+
+  int errnum = error_options.capture_errno ? errno : 0;
+
+  // a JS callback invoked during the call may have thrown
+  if (env.IsExceptionPending())
+    return env.Undefined();
+
+  if (error_options.capture_errno)
+    InstanceData::Get(env)->last_errno = errnum;
+  if (ResultIsError(error_options.policy, kind, &result))
+    throw ErrnoError(env, errnum, error_options.name);
+
+  NarrowResult(kind, &result);
+  return ReadValue(env, kind, &result, args[4].ToBoolean());
+}
+
+/*
+ * Generates the machine code call stub for an `ffi_cif *`.
+ *
+ * args[0] - Buffer - the `ffi_cif *`
+ *
+ * returns a Buffer pointing to the stub, or `null` when the cif can't be
+ * called through one on this platform
+ */
+
+Value FFI::FFICallStub(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  if (!args[0].IsBuffer()) {
+    throw TypeError::New(env, "ffi_call_stub() requires a Buffer argument!");
+  }
+
+  ffi_cif* cif = GetBufferData<ffi_cif>(args[0]);
+  void* writable;
+  CallStub stub = NewCallStub(cif, &writable);
+  if (stub == nullptr) {
+    return env.Null();
+  }
+
+  return Buffer<char>::New(env, reinterpret_cast<char*>(stub), 0,
+                           [writable](Env, char*) { FreeCallStub(writable); });
 }
 
 /*
@@ -263,6 +793,19 @@ void FFI::FFICall(const Napi::CallbackInfo& args) {
  * args[2] - Buffer - the `void *` buffer big enough to hold the return value
  * args[3] - Buffer - the `void **` array of pointers containing the arguments
  * args[4] - Function - the callback function to invoke when complete
+ * args[5] - Number - the error flags (optional, see ErrorOptions)
+ * args[6] - Number - the ValueKind of the return value, for the error policy
+ * args[7] - String - the function's name, for error messages
+ * args[8] - Boolean - queue the call on the libuv threadpool instead of the
+ *           FFI worker pool
+ * args[9] - String - queue the call on the serial executor with this key
+ *           instead
+ * args[10] - Object - the call's options, `signal` and `timeout` (see
+ *            `AsyncCallParams::SetCallOptions()`)
+ * args[11] - Number - the function's default timeout in milliseconds
+ * args[12] - String - the function's default priority
+ * args[13] - External - the function's caps on async calls, if any (see
+ *            `AsyncLimits`)
  */
 
 void FFI::FFICallAsync(const Napi::CallbackInfo& args) {
@@ -275,21 +818,51 @@ void FFI::FFICallAsync(const Napi::CallbackInfo& args) {
     throw TypeError::New(env, "ffi_call_async() requires a function argument");
   }
 
+  WorkerPool* queue = nullptr;
+  if (!args[8].ToBoolean()) {
+    queue = args[9].IsString() ?
+        InstanceData::Get(env)->Executor(args[9].As<String>()) :
+        InstanceData::Get(env)->Pool();
+  }
+
+  AsyncLimits* own_limits = AsyncLimits::From(args[13]);
+  if (!AsyncLimits::AdmitCall(InstanceData::Get(env), own_limits)) {
+    AsyncLimits::Refuse(env, false);  // throws
+    return;
+  }
+
   // store a persistent references to all the Buffers and the callback function
-  AsyncCallParams* p = new AsyncCallParams(env);
+  AsyncCallParams* p = InstanceData::Get(env)->NewAsyncCall();
   p->cif = GetBufferData<ffi_cif>(args[0]);
   p->fn = GetBufferData<char>(args[1]);
   p->res = GetBufferData<char>(args[2]);
   p->argv = GetBufferData<void*>(args[3]);
+  p->error_options.Parse(args[5], args[7]);
+  p->rkind = static_cast<ValueKind>(args[6].ToNumber().Uint32Value());
 
   p->result = FFI_OK;
   p->callback = Reference<Function>::New(args[4].As<Function>(), 1);
   p->req.data = p;
 
-  uv_queue_work(get_uv_event_loop(env),
-                &p->req,
-                FFI::AsyncFFICall,
-                FFI::FinishAsyncFFICall);
+  try {
+    p->SetCallOptions(env, args[10], args[11].ToNumber().Uint32Value(),
+                      ParsePriority(env, args[12], Priority::kNormal), queue);
+    p->Track(env, false);
+  } catch (...) {
+    InstanceData::Get(env)->FreeAsyncCall(p);
+    throw;
+  }
+
+  p->Submit(InstanceData::Get(env), own_limits);
+  if (queue == nullptr) {
+    uv_queue_work(get_uv_event_loop(env),
+                  &p->req,
+                  FFI::AsyncFFICall,
+                  FFI::FinishAsyncFFICall);
+  } else {
+    queue->Queue(&p->req, FFI::AsyncFFICall, FFI::FinishAsyncFFICall,
+                 p->priority);
+  }
 }
 
 /*
@@ -297,12 +870,20 @@ void FFI::FFICallAsync(const Napi::CallbackInfo& args) {
  */
 void FFI::AsyncFFICall(uv_work_t* req) {
   AsyncCallParams* p = static_cast<AsyncCallParams*>(req->data);
+  if (!p->Start())
+    return;
 
   try {
+    if (p->error_options.capture_errno)
+      errno = 0;
     ffi_call(p->cif, FFI_FN(p->fn), p->res, p->argv);
+    // `errno` is thread-local, so this has to happen on the same thread
+    if (p->error_options.capture_errno)
+      p->errnum = errno;
   } catch (std::exception& e) {
     p->err = e.what();
   }
+  p->Stop();
 }
 
 /*
@@ -318,14 +899,16 @@ void FFI::FinishAsyncFFICall(uv_work_t* req, int status) {
   std::vector<napi_value> argv = { env.Null() };
   if (p->result != FFI_OK) {
     argv[0] = String::New(env, p->err);
+  } else if (p->Dropped()) {
+    argv[0] = p->DroppedError(env).Value();
+  } else if (ResultIsError(p->error_options.policy, p->rkind, p->res)) {
+    argv[0] = ErrnoError(env, p->errnum, p->error_options.name).Value();
+  } else if (p->error_options.capture_errno) {
+    argv.push_back(Number::New(env, p->errnum));
   }
 
-  // invoke the registered callback function
-  // TODO: Track napi_async_context properly
-  p->callback.MakeCallback(Object::New(env), argv);
-
-  // free up our memory (allocated in FFICallAsync)
-  delete p;
+  // invoke the registered callback function, in the context of the call
+  p->Deliver(env, p->callback.Value(), argv);
 }
 
 Value InitializeBindings(const Napi::CallbackInfo& args) {
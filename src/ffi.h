@@ -7,8 +7,12 @@
 #define __STDC_LIMIT_MACROS true
 #endif
 #include <stdint.h>
-#include <queue>
+#include <stddef.h>
+#include <atomic>
+#include <deque>
 #include <memory>
+#include <string>
+#include <vector>
 #include <unordered_map>
 
 #ifdef WIN32
@@ -30,25 +34,53 @@ namespace FFI {
 using namespace Napi;
 
 class InstanceData;
+class AsyncCallParams;
+class WorkerPool;
+class CallChain;
+class CallRing;
+class AsyncLimits;
 
 /*
- * Class used to store stuff during async ffi_call() invokations.
+ * Per-function error handling: whether `errno` gets captured right after the
+ * call, and which return values count as a failure. A failed call throws an
+ * Error carrying the captured `errno`. From JS-land, these come as a flags
+ * Number (bit 0: capture errno, the other bits: the ErrorPolicy) and the
+ * function's name for error messages.
  */
 
-class AsyncCallParams {
-  public:
-    explicit AsyncCallParams(Env env_) : env(env_) {}
-    Env env;
-    ffi_status result;
-    std::string err;
-    ffi_cif* cif;
-    char* fn;
-    char* res;
-    void** argv;
-    FunctionReference callback;
-    uv_work_t req;
+enum class ErrorPolicy : uint8_t {
+  kNone = 0,
+  kNegative,  // the return value is < 0
+  kNonZero,   // the return value is not 0
+  kZero       // the return value is 0, false or a NULL pointer
+};
+
+struct ErrorOptions {
+  bool capture_errno = false;
+  ErrorPolicy policy = ErrorPolicy::kNone;
+  std::string name;
+
+  void Parse(Value flags, Value name);
 };
 
+Error ErrnoError(Env env, int errnum, const std::string& name);
+
+/*
+ * The scheduling class of an async call on the FFI worker pool. Workers take
+ * the tasks of higher classes first, but lower classes still get a minimum
+ * share of the picks (see `WorkerPool::Take()`).
+ */
+
+enum class Priority : uint8_t {
+  kInteractive = 0,
+  kNormal,
+  kBulk
+};
+
+static const size_t kNumPriorities = 3;
+
+Priority ParsePriority(Env env, Value name, Priority fallback);
+
 class FFI {
   public:
     static Object InitializeStaticFunctions(Env env);
@@ -58,11 +90,401 @@ class FFI {
     static Value FFIPrepCif(const Napi::CallbackInfo& args);
     static Value FFIPrepCifVar(const Napi::CallbackInfo& args);
     static void FFICall(const Napi::CallbackInfo& args);
+    static Value FFICallStub(const Napi::CallbackInfo& args);
+    static Value FFICallValue(const Napi::CallbackInfo& args);
     static void FFICallAsync(const Napi::CallbackInfo& args);
     static void AsyncFFICall(uv_work_t* req);
     static void FinishAsyncFFICall(uv_work_t* req, int status);
 };
 
+/*
+ * The JS value conversions that can be done natively, without going through
+ * the "ref" type's `get()`/`set()` functions. Every "ref" type that maps onto
+ * one of these gets marshalled in C++; anything else (structs, arrays, custom
+ * types) takes the generic Buffer-based path in JS-land.
+ */
+
+enum class ValueKind : uint8_t {
+  kVoid = 0,
+  kInt8,
+  kUint8,
+  kInt16,
+  kUint16,
+  kInt32,
+  kUint32,
+  kInt64,
+  kUint64,
+  kFloat,
+  kDouble,
+  kBool,
+  kPointer,
+  kCString
+};
+
+const char* ValueKindName(ValueKind kind);
+size_t ValueKindSize(ValueKind kind);
+void WriteValue(Env env, ValueKind kind, Value val, void* dst, std::string* str);
+Value ReadValue(Env env, ValueKind kind, const void* src, bool bigint = false);
+void NarrowResult(ValueKind kind, void* rvalue);
+void WidenResult(ValueKind kind, void* rvalue);
+bool ResultIsError(ErrorPolicy policy, ValueKind kind, const void* rvalue);
+
+/*
+ * Direct-call thunks for all-scalar signatures (see call_thunks.cc). The
+ * thunk receives the integer and floating point register values separately.
+ */
+
+static const size_t kMaxThunkInts = 6;
+static const size_t kMaxThunkDoubles = 8;
+
+struct ThunkSlot {
+  bool fp;        // passed in a floating point register
+  uint8_t index;  // position among the integer or floating point arguments
+};
+
+typedef void (*CallThunk)(void* fn,
+                          const uint64_t* ints,
+                          const double* doubles,
+                          void* rvalue);
+
+CallThunk FindCallThunk(ffi_cif* cif,
+                        bool variadic,
+                        ValueKind rkind,
+                        const std::vector<ValueKind>& kinds,
+                        std::vector<ThunkSlot>* slots);
+void WidenInteger(ValueKind kind, uint64_t* slot);
+
+/*
+ * Machine code call stubs, generated once per cif (see call_jit.cc). They
+ * take the same arguments as `ffi_call()`, minus the cif.
+ */
+
+typedef void (*CallStub)(void (*fn)(void), void* rvalue, void** avalue);
+
+CallStub NewCallStub(ffi_cif* cif, void** writable);
+void FreeCallStub(void* writable);
+
+/*
+ * A CallPlan gets created once per ForeignFunction whose argument and return
+ * types all have a ValueKind. Its `Invoke()` function *is* the JS proxy
+ * function: it writes the JS arguments straight into a native call frame,
+ * invokes the function and decodes the return value, so that no Buffers need
+ * to be allocated per call.
+ */
+
+class CallPlan {
+  public:
+    static Value New(const Napi::CallbackInfo& args);
+    static Value Invoke(const Napi::CallbackInfo& args);
+    static Value Batch(const Napi::CallbackInfo& args);
+    static Value Map(const Napi::CallbackInfo& args);
+    static Value Async(const Napi::CallbackInfo& args);
+    static void AsyncWork(uv_work_t* req);
+    static void FinishAsync(uv_work_t* req, int status);
+    static void FlushCompletions(void* data);
+    static void Release(Env env, CallPlan* plan);
+
+    void PrepareFrame();
+    template <typename Args>
+    void Marshal(Env env, const Args& args, size_t* i,
+                 void** avalue, std::string* strings,
+                 uint64_t* ints, double* doubles);
+    template <typename Args>
+    bool Call(Env env, const Args& args,
+              void* rvalue, void** avalue, std::string* strings);
+    void LoadRegisters(void** avalue, uint64_t* ints, double* doubles) const;
+    int Execute(void* rvalue, void** avalue,
+                const uint64_t* ints, const double* doubles);
+    Value DecodeResult(Env env, void* rvalue);
+
+    ffi_cif* cif;
+    char* fn;
+    ValueKind rkind;
+    std::vector<ValueKind> kinds;
+    ErrorOptions error_options;
+    InstanceData* instance;
+
+    // when set, the function is called through this instead of `ffi_call()`
+    CallThunk thunk = nullptr;
+    std::vector<ThunkSlot> thunk_slots;
+
+    // otherwise, the cif's call stub is used if there is one
+    CallStub stub = nullptr;
+    ObjectReference stub_buf;
+
+    // the return "type" set on returned pointer Buffers, and their length
+    ObjectReference rtype;
+    size_t rsize;
+    bool bigint = false;
+
+    // keep the `ffi_cif *` and function pointer Buffers alive
+    ObjectReference cif_buf;
+    ObjectReference fn_buf;
+
+    // The preallocated call frame: a single slab holding the result slot
+    // and the argument slots, laid out from the cif's types, with `avalue`
+    // permanently pointing into it. Reentrant calls (from a JS callback that
+    // the function itself invoked) find it `busy` and use the C stack.
+    std::unique_ptr<max_align_t[]> slab;
+    std::vector<void*> avalue;
+    std::vector<std::string> strings;
+    bool busy = false;
+
+    // The callbacks of pending `async()` calls, at `2 * slot`, each followed
+    // by its arguments if they need to be kept alive, and the free slots.
+    ObjectReference pending;
+    std::vector<uint32_t> free_slots;
+    uint32_t num_slots = 0;
+    bool keep_args = false;  // there are pointer or string arguments
+    bool uv_pool = false;    // queue on the libuv threadpool
+    WorkerPool* executor = nullptr;  // or on this serial executor
+    uint32_t timeout = 0;  // default deadline of `async()` calls, in ms
+    Priority priority = Priority::kNormal;  // and their default priority
+    AsyncLimits* limits = nullptr;  // the caps of its Library, if any
+
+    // With a completion handler, `async()` takes a tag instead of a callback,
+    // and the completions are collected as [tag, err, result] triples, which
+    // get delivered to the handler in one Array per wakeup of the pool.
+    FunctionReference completion_handler;
+    ObjectReference completed;
+    uint32_t num_completed = 0;
+
+    // the number of JS functions and pending `async()` calls using the plan
+    size_t refs = 0;
+};
+
+/*
+ * A sequence of CallPlan calls that runs on a worker thread as a whole (see
+ * call_chain.cc). Every argument of every step is either a constant, one of
+ * the chain's inputs, or the result of an earlier step.
+ */
+
+class CallChain {
+  public:
+    static Value New(const Napi::CallbackInfo& args);
+    static Value Async(const Napi::CallbackInfo& args);
+    static void Work(uv_work_t* req);
+    static void Finish(uv_work_t* req, int status);
+    static void Release(Env env, CallChain* chain);
+
+    enum class Source : uint8_t { kConstant = 0, kInput, kResult };
+
+    struct Step {
+      CallPlan* plan;
+      std::vector<Source> sources;
+      // the constant, input or step number of every argument
+      std::vector<uint32_t> indices;
+      size_t avalue_offset;  // where its arguments start in `avalue`
+    };
+
+    std::vector<Step> steps;
+    std::vector<ValueKind> input_kinds;
+    size_t num_args = 0;
+    bool keep_inputs = false;  // there are pointer or string inputs
+    InstanceData* instance;
+
+    // the constant arguments, converted once; `steps_desc` keeps the JS
+    // values (Buffers in particular) alive
+    std::vector<uint64_t> constants;
+    std::vector<std::string> constant_strings;
+    ObjectReference steps_desc;
+
+    // like `CallPlan::pending`, for the callbacks and inputs
+    ObjectReference pending;
+    std::vector<uint32_t> free_slots;
+    uint32_t num_slots = 0;
+    size_t refs = 0;
+};
+
+/*
+ * A pair of submission and completion rings in SharedArrayBuffers, through
+ * which JS-land queues calls of a fixed set of CallPlans without going
+ * through N-API for every call (see call_ring.cc and lib/ring.js). Both are
+ * single-producer, single-consumer: JS-land writes the submissions and reads
+ * the completions, and at most one worker at a time does the opposite.
+ */
+
+class CallRing {
+  public:
+    static Value New(const Napi::CallbackInfo& args);
+    static Value Notify(const Napi::CallbackInfo& args);
+    static void Drain(uv_work_t* req);
+    static void Finish(uv_work_t* req, int status);
+    static void Release(Env env, CallRing* ring);
+
+    // each ring starts with its head and tail indices, on cache lines of
+    // their own, followed by the entries
+    static const size_t kHeadOffset = 0;
+    static const size_t kTailOffset = 64;
+    static const size_t kEntriesOffset = 128;
+    // a completion: the tag, the function's index, the error (0 for none),
+    // padding, and the 8-byte result
+    static const size_t kCompletionSize = 24;
+
+    bool SubmissionsPending() const;
+
+    std::vector<CallPlan*> plans;
+    uint32_t entries;  // per ring, a power of 2
+    size_t entry_size;  // of a submission: function index, tag, arguments
+    uint8_t* sq;
+    uint8_t* cq;
+    InstanceData* instance;
+    ObjectReference buffers;  // keeps both SharedArrayBuffers alive
+    FunctionReference on_completion;
+
+    Priority priority = Priority::kNormal;
+    std::vector<void*> avalue;  // for the one worker draining the ring
+
+    uv_work_t req;
+    bool queued = false;  // `req` is queued or running
+    size_t refs = 0;
+};
+
+/*
+ * A log-linear histogram of durations, in microseconds: 4 buckets per power
+ * of 2, so a percentile read off it is within 12.5% of the actual value.
+ * Worker threads record into it concurrently.
+ */
+
+class DurationHistogram {
+  public:
+    void Record(uint64_t nanoseconds);
+    double Percentile(double p) const;  // in milliseconds
+    void Reset();
+
+  private:
+    static const size_t kNumBuckets = 160;
+    std::atomic<uint64_t> buckets[kNumBuckets] = {};
+};
+
+/*
+ * Caps on the async calls in flight (queued or running, until their callback
+ * has been called) and on those still queued, along with the gauges behind
+ * them (see async_limits.cc). There's one for all the calls, and any number
+ * of others that apply to the calls of particular functions, e.g. those of a
+ * Library.
+ */
+
+class AsyncLimits {
+  public:
+    static Value New(const Napi::CallbackInfo& args);
+    static Value Configure(const Napi::CallbackInfo& args);
+    static Value Full(const Napi::CallbackInfo& args);
+    static Value Stats(const Napi::CallbackInfo& args);
+    static AsyncLimits* From(Value value);
+    static bool AdmitCall(InstanceData* instance, AsyncLimits* own);
+    static Value Refuse(Env env, bool promise);
+    static void Release(AsyncLimits* limits);
+
+    bool AtCap() const;
+    bool Admit();
+    void Submitted();
+    void Started(uint64_t wait, bool running);
+    void Stopped(uint64_t run);
+    void Completed(Env env, bool started);
+
+    // 0 for no cap
+    uint32_t max_in_flight = 0;
+    uint32_t max_queued = 0;
+    // accept calls over the caps, and invoke `on_drain` once there's room
+    // again, rather than refusing them
+    bool backpressure = false;
+    bool full = false;
+    FunctionReference on_drain;
+
+    // `in_flight` and the totals only change on the loop thread
+    uint32_t in_flight = 0;
+    std::atomic<uint32_t> queued{0};
+    std::atomic<uint32_t> running{0};
+    uint64_t completed = 0;
+    uint64_t refused = 0;
+    DurationHistogram queue_wait;
+    DurationHistogram run_time;
+
+    // the JS handle, the functions and the calls in flight using it
+    size_t refs = 0;
+};
+
+/*
+ * Where an async call is at, as far as withdrawing it goes. Only a call that
+ * is still queued can be aborted, or dropped once its deadline passed.
+ */
+
+enum class AsyncState : uint8_t {
+  kQueued = 0,
+  kRunning,
+  kAborted,  // through the call's AbortSignal
+  kExpired   // its deadline passed before it started
+};
+
+/*
+ * Class used to store stuff during async ffi_call() invokations.
+ */
+
+class AsyncCallParams {
+  public:
+    explicit AsyncCallParams(Env env_) : env(env_) {}
+
+    void SetCallOptions(Env env, Value options, uint32_t timeout,
+                        Priority priority, WorkerPool* queue);
+    bool Start();
+    bool Dropped() const;
+    Error DroppedError(Env env);
+    void Detach(Env env);
+    static Value OnAbort(const Napi::CallbackInfo& info);
+    Value Track(Env env, bool promise);
+    void Submit(InstanceData* instance, AsyncLimits* own);
+    void Stop();
+    void Deliver(Env env, Value callback, const std::vector<napi_value>& argv);
+
+    Env env;
+    ffi_status result;
+    std::string err;
+    ffi_cif* cif;
+    char* fn;
+    char* res;
+    void** argv;
+    FunctionReference callback;
+    uv_work_t req;
+    ErrorOptions error_options;
+    ValueKind rkind;
+    int errnum = 0;
+
+    // Set for `CallPlan::Async()` calls, whose arguments are marshalled into
+    // the storage below. That storage only ever grows, as these objects get
+    // reused (see `InstanceData::NewAsyncCall()`).
+    CallPlan* plan = nullptr;
+    CallChain* chain = nullptr;  // or `CallChain::Async()` calls
+    uint32_t slot = 0;  // where the callback is kept in `plan->pending`
+    size_t failed_step = 0;
+    std::vector<uint64_t> values;  // the result, then one per argument
+    std::vector<void*> avalue;
+    std::vector<std::string> strings;
+    uint64_t ints[kMaxThunkInts];
+    double doubles[kMaxThunkDoubles];
+
+    // cancellation (see `SetCallOptions()`)
+    std::atomic<AsyncState> state{AsyncState::kQueued};
+    uint64_t deadline = 0;  // in `uv_hrtime()` nanoseconds, 0 for none
+    WorkerPool* queue = nullptr;  // what it was queued on, null for libuv
+    Priority priority = Priority::kNormal;
+    ObjectReference signal;
+    FunctionReference abort_listener;
+    AsyncCallParams** abort_token = nullptr;  // the listener's way to the call
+
+    // the async context the call was made in, and the promise it returned
+    // instead of taking a callback, if any (see `Track()`)
+    napi_async_context context = nullptr;
+    napi_deferred deferred = nullptr;
+
+    // the caps the call counts against, the global ones and possibly those of
+    // its function, and its timings (see `Submit()`)
+    AsyncLimits* limits[2] = { nullptr, nullptr };
+    uint64_t queued_at = 0;
+    uint64_t started_at = 0;
+    bool waiting = false;  // not picked up by a worker yet
+};
+
 /*
  * One of these structs gets created for each `ffi.Callback()` invokation in
  * JavaScript-land. It contains all the necessary information when invoking the
@@ -82,6 +504,22 @@ struct callback_info {
   int argc;                      // the number of arguments this function expects
   size_t resultSize;             // the size of the result pointer
   InstanceData* instance_data;
+  // invocations from other threads return right away, without waiting for
+  // the JS function, which gets copies of the arguments instead, including
+  // the C strings that these flags are set for (void callbacks only)
+  bool nonblocking = false;
+  std::vector<bool> copy_strings;
+  // such invokations that haven't run yet, which the struct has to outlive
+  std::atomic<size_t> detached{0};
+  bool collected = false;
+  // with all the types having a ValueKind (return value first), the
+  // arguments get decoded and the return value encoded natively, and the
+  // pointer arguments get these "type"s and lengths (see callback.js)
+  std::vector<ValueKind> kinds;
+  ObjectReference pointer_types;
+  std::vector<size_t> pointer_sizes;
+  // the Buffer of the cif it has been prepared for, held weakly
+  ObjectReference cif_buf;
 };
 
 class ThreadedCallbackInvokation;
@@ -90,11 +528,19 @@ class CallbackInfo {
   public:
     static Function Initialize(Env env);
     static void WatcherCallback(uv_async_t* w);
+    static void FreeClosure(callback_info* info);
+    static void DropClosures(std::vector<callback_info*>* closures);
+    static Value SweepClosures(const Napi::CallbackInfo& args);
+
+    // the closures of collected callbacks kept per signature, at most
+    static const size_t kMaxFreeClosures = 64;
 
   protected:
     static void DispatchToV8(callback_info* self, void* retval, void** parameters, bool dispatched = false);
+    static void CallDecoded(callback_info* self, void* retval, void** parameters, bool dispatched);
     static void Invoke(ffi_cif* cif, void* retval, void** parameters, void* user_data);
     static Value Callback(const Napi::CallbackInfo& info);
+    static callback_info* NewClosure(Env env, ffi_cif* cif, Object cif_buf);
 };
 
 /**
@@ -104,13 +550,19 @@ class CallbackInfo {
  *   -> WaitForExecution()     returned
  *
  *   ^WaitForExecution() must always be called from the thread which owns the object
+ *
+ *   The object must not be touched by the loop thread after SignalDoneExecuting(),
+ *   as the owning thread goes on to reuse it (see ForThisThread()).
  */
 
 class ThreadedCallbackInvokation {
   public:
-    ThreadedCallbackInvokation(callback_info* cbinfo, void* retval, void** parameters);
+    ThreadedCallbackInvokation(callback_info* cbinfo, void* retval, void** parameters, bool detached = false);
     ~ThreadedCallbackInvokation();
 
+    static ThreadedCallbackInvokation* Copy(callback_info* cbinfo, ffi_cif* cif, void** parameters);
+    static ThreadedCallbackInvokation* ForThisThread(callback_info* cbinfo, void* retval, void** parameters);
+
     void SignalDoneExecuting();
     void WaitForExecution();
 
@@ -118,9 +570,91 @@ class ThreadedCallbackInvokation {
     void** m_parameters;
     callback_info* m_cbinfo;
 
+    // the link in `InstanceData::callbacks`
+    ThreadedCallbackInvokation* m_next = nullptr;
+
+    // nobody waits for a detached invokation, which owns copies of the
+    // arguments instead (see `Copy()`), and gets deleted once it has run
+    bool m_detached;
+    std::unique_ptr<max_align_t[]> m_storage;
+
   private:
-    uv_cond_t m_cond;
-    uv_mutex_t m_mutex;
+    uv_sem_t m_sem;
+};
+
+/*
+ * A dedicated thread pool for `ffi_call_async()` (see worker_pool.cc), so that
+ * long-running foreign calls don't take up the libuv threadpool, which the
+ * fs, dns and zlib modules depend on.
+ */
+
+class WorkerPool {
+  public:
+    struct Options {
+      size_t size = 4;
+      std::string name = "ffi-worker";
+      size_t stack_size = 0;  // 0 for the platform's default
+      // run all the completions of a wakeup in one callback scope
+      bool coalesce = false;
+      // ignore the priorities, and run the tasks in the order they came in
+      bool fifo = false;
+    };
+
+    WorkerPool(Env env, const Options& options);
+    ~WorkerPool();
+
+    void Queue(uv_work_t* req, uv_work_cb work, uv_after_work_cb after,
+               Priority priority = Priority::kNormal);
+    bool Cancel(uv_work_t* req);
+    bool Defer(void (*fn)(void* data), void* data);
+    void Dispose();
+    // whether any of the worker threads could be started
+    bool Started() const { return !workers.empty(); }
+
+    static Value Configure(const Napi::CallbackInfo& args);
+
+  private:
+    struct Task {
+      uv_work_t* req;
+      uv_work_cb work;
+      uv_after_work_cb after;
+    };
+
+    struct Worker {
+      WorkerPool* pool;
+      size_t index;
+      uv_thread_t thread;
+      uv_mutex_t mutex;
+      std::deque<Task> tasks[kNumPriorities];  // one queue per Priority
+      uint32_t takes = 0;  // only ever touched by the worker's own thread
+    };
+
+    static void Run(void* arg);
+    static void Complete(uv_async_t* handle);
+    bool Take(Worker* self, Task* task);
+    bool TakeFrom(Worker* self, size_t priority, Task* task);
+
+    Env env;
+    Options options;
+    std::vector<std::unique_ptr<Worker>> workers;
+    size_t next = 0;       // the worker to queue the next task on
+    size_t in_flight = 0;  // queued tasks whose `after` hasn't run yet
+
+    // for `Complete()`: the async context of the coalesced callback scope,
+    // and the functions to run once all the completions have been delivered
+    napi_async_context context = nullptr;
+    bool draining = false;
+    std::vector<std::pair<void (*)(void*), void*>> deferred;
+
+    // protects the fields below
+    uv_mutex_t mutex;
+    uv_cond_t wakeup;
+    size_t queued = 0;  // tasks not claimed by any worker yet
+    size_t active = 0;  // tasks being run right now
+    bool stopping = false;
+    std::vector<Task> done;
+
+    uv_async_t async;
 };
 
 class InstanceData final {
@@ -130,6 +664,33 @@ class InstanceData final {
   Env env;
   RefNapi::Instance* ref_napi_instance = nullptr;
 
+  // the `errno` captured after the last synchronous call of a function with
+  // the "errno" option
+  int last_errno = 0;
+
+  // the FFI worker pool, started by the first async call that uses it
+  WorkerPool* pool = nullptr;
+  WorkerPool::Options pool_options;
+  WorkerPool* Pool();
+
+  // the serial executors: single-threaded pools, by affinity key
+  std::unordered_map<std::string, WorkerPool*> executors;
+  WorkerPool* Executor(const std::string& key);
+
+  // the caps and gauges of all the async calls
+  AsyncLimits* limits = nullptr;
+  AsyncLimits* Limits();
+
+  // request objects for `ffi_call_async()` that can be reused
+  std::vector<AsyncCallParams*> free_async_calls;
+  AsyncCallParams* NewAsyncCall();
+  void FreeAsyncCall(AsyncCallParams* p);
+
+  // prepared closures of collected callbacks that can be reused, by cif (see
+  // `CallbackInfo::NewClosure()`)
+  std::unordered_map<ffi_cif*, std::vector<callback_info*>> free_closures;
+
+  ~InstanceData();
   void Dispose();
 
 #ifdef WIN32
@@ -137,8 +698,10 @@ class InstanceData final {
 #else
   uv_thread_t thread;
 #endif
-  uv_mutex_t mutex;
-  std::queue<ThreadedCallbackInvokation*> queue;
+  // callbacks invoked on other threads, waiting for the loop thread to run
+  // them: a lock-free stack that any thread can push onto, and that the loop
+  // thread takes as a whole (see `CallbackInfo::WatcherCallback()`)
+  std::atomic<ThreadedCallbackInvokation*> callbacks{nullptr};
   uv_async_t async;
 
   static InstanceData* Get(Env env);
@@ -1,31 +1,102 @@
+#include <string.h>
+#include <algorithm>
 #include "ffi.h"
 
 namespace FFI {
 
-ThreadedCallbackInvokation::ThreadedCallbackInvokation(callback_info* cbinfo, void* retval, void** parameters) {
+ThreadedCallbackInvokation::ThreadedCallbackInvokation(callback_info* cbinfo, void* retval, void** parameters, bool detached) {
   m_cbinfo = cbinfo;
   m_retval = retval;
   m_parameters = parameters;
-
-  uv_mutex_init(&m_mutex);
-  uv_mutex_lock(&m_mutex);
-  uv_cond_init(&m_cond);
+  m_detached = detached;
+  if (!detached)
+    uv_sem_init(&m_sem, 0);
 }
 
 ThreadedCallbackInvokation::~ThreadedCallbackInvokation() {
-  uv_mutex_unlock(&m_mutex);
-  uv_cond_destroy(&m_cond);
-  uv_mutex_destroy(&m_mutex);
+  if (!m_detached)
+    uv_sem_destroy(&m_sem);
+}
+
+/*
+ * The invokation that the calling thread reuses for all of its blocking
+ * invokations, so that a thread calling back over and over doesn't set up and
+ * tear down a semaphore each time. A thread only ever waits for one of them
+ * at a time, and it lives until the thread exits.
+ */
+
+ThreadedCallbackInvokation* ThreadedCallbackInvokation::ForThisThread(callback_info* cbinfo, void* retval, void** parameters) {
+  static thread_local std::unique_ptr<ThreadedCallbackInvokation> inv;
+  if (!inv)
+    inv.reset(new ThreadedCallbackInvokation(cbinfo, retval, parameters));
+  inv->m_cbinfo = cbinfo;
+  inv->m_retval = retval;
+  inv->m_parameters = parameters;
+  inv->m_next = nullptr;
+  return inv.get();
+}
+
+static size_t AlignStorage(size_t size) {
+  return (size + alignof(max_align_t) - 1) & ~(alignof(max_align_t) - 1);
+}
+
+/*
+ * Creates a detached invokation of a nonblocking callback, with the argument
+ * values (per the cif's types) and the C strings they point to copied into
+ * storage of its own, in one block: the parameters array, room for the
+ * return value, the values, then the strings.
+ */
+
+ThreadedCallbackInvokation* ThreadedCallbackInvokation::Copy(callback_info* cbinfo, ffi_cif* cif, void** parameters) {
+  size_t nargs = cif->nargs;
+  size_t size = AlignStorage(sizeof(void*) * nargs) +
+      AlignStorage(std::max(cbinfo->resultSize, sizeof(ffi_arg)));
+  for (size_t i = 0; i < nargs; i++)
+    size += AlignStorage(cif->arg_types[i]->size);
+  // only the slots of string arguments hold a pointer to read
+  for (size_t i = 0; i < nargs && i < cbinfo->copy_strings.size(); i++) {
+    if (!cbinfo->copy_strings[i])
+      continue;
+    const char* str = *static_cast<const char**>(parameters[i]);
+    if (str != nullptr)
+      size += strlen(str) + 1;
+  }
+
+  std::unique_ptr<max_align_t[]> storage(
+      new max_align_t[(size + sizeof(max_align_t) - 1) / sizeof(max_align_t)]);
+  char* data = reinterpret_cast<char*>(storage.get());
+  void** params = reinterpret_cast<void**>(data);
+  char* retval = data + AlignStorage(sizeof(void*) * nargs);
+  char* next = retval + AlignStorage(std::max(cbinfo->resultSize, sizeof(ffi_arg)));
+  for (size_t i = 0; i < nargs; i++) {
+    params[i] = next;
+    memcpy(next, parameters[i], cif->arg_types[i]->size);
+    next += AlignStorage(cif->arg_types[i]->size);
+  }
+  for (size_t i = 0; i < nargs && i < cbinfo->copy_strings.size(); i++) {
+    if (!cbinfo->copy_strings[i])
+      continue;
+    const char* str = *static_cast<const char**>(parameters[i]);
+    if (str == nullptr)
+      continue;
+    size_t length = strlen(str) + 1;
+    memcpy(next, str, length);
+    *static_cast<char**>(params[i]) = next;
+    next += length;
+  }
+
+  ThreadedCallbackInvokation* inv =
+      new ThreadedCallbackInvokation(cbinfo, retval, params, true);
+  inv->m_storage = std::move(storage);
+  return inv;
 }
 
 void ThreadedCallbackInvokation::SignalDoneExecuting() {
-  uv_mutex_lock(&m_mutex);
-  uv_cond_signal(&m_cond);
-  uv_mutex_unlock(&m_mutex);
+  uv_sem_post(&m_sem);
 }
 
 void ThreadedCallbackInvokation::WaitForExecution() {
-  uv_cond_wait(&m_cond, &m_mutex);
+  uv_sem_wait(&m_sem);
 }
 
 }
@@ -0,0 +1,409 @@
+#include <assert.h>
+#include <algorithm>
+#include "ffi.h"
+#include <get-uv-event-loop-napi.h>
+
+#if !defined(WIN32)
+#include <pthread.h>
+#endif
+
+namespace FFI {
+
+/*
+ * The FFI worker pool.
+ *
+ * `Queue()` is only ever called on the loop thread. It hands tasks to the
+ * workers round-robin; a worker runs the tasks of its own queues in order and,
+ * when those are empty, steals from the back of the other workers' queues, so
+ * that one long-running foreign call doesn't hold up the tasks queued behind
+ * it. Every worker has one queue per Priority. `queued` counts the tasks that
+ * have not been claimed by any worker yet, so a worker that claimed one is
+ * guaranteed to find it in some queue.
+ *
+ * Finished tasks are handed back to the loop thread through `async`, which is
+ * only ref'd while tasks are in flight, like libuv's own threadpool. All the
+ * tasks that finished by the time the loop thread gets to them are completed
+ * in one go.
+ */
+
+WorkerPool::WorkerPool(Env env_, const Options& options_)
+    : env(env_), options(options_) {
+  uv_mutex_init(&mutex);
+  uv_cond_init(&wakeup);
+
+  uv_loop_t* loop = get_uv_event_loop(env);
+  uv_async_init(loop, &async, Complete);
+  async.data = this;
+  uv_unref(reinterpret_cast<uv_handle_t*>(&async));
+
+  // lives as long as the environment, so it never gets destroyed
+  if (options.coalesce) {
+    napi_value name = String::New(env, "ffi:completions");
+    napi_async_init(env, nullptr, name, &context);
+  }
+
+  for (size_t i = 0; i < options.size; i++) {
+    std::unique_ptr<Worker> worker(new Worker());
+    worker->pool = this;
+    worker->index = i;
+    uv_mutex_init(&worker->mutex);
+    workers.push_back(std::move(worker));
+  }
+
+  for (size_t i = 0; i < workers.size(); i++) {
+    int err;
+#if UV_VERSION_HEX >= 0x011a00
+    uv_thread_options_t thread_options;
+    thread_options.flags = UV_THREAD_HAS_STACK_SIZE;
+    thread_options.stack_size = options.stack_size;
+    err = uv_thread_create_ex(&workers[i]->thread, &thread_options,
+                              Run, workers[i].get());
+#else
+    err = uv_thread_create(&workers[i]->thread, Run, workers[i].get());
+#endif
+    if (err != 0) {
+      // keep the workers that did start
+      for (size_t j = i; j < workers.size(); j++)
+        uv_mutex_destroy(&workers[j]->mutex);
+      workers.resize(i);
+      break;
+    }
+  }
+}
+
+/*
+ * Queues `work(req)` on the pool, with `after(req, 0)` to be called on the
+ * loop thread when it's done, just like `uv_queue_work()`.
+ *
+ * If none of the shared pool's worker threads could be started, its calls
+ * fall back to libuv's threadpool, which has no priorities, and they can't
+ * be withdrawn with `Cancel()` anymore. That would break the thread affinity
+ * and the ordering of a serial executor, which therefore never gets here
+ * without its thread (see `InstanceData::Executor()`).
+ */
+
+void WorkerPool::Queue(uv_work_t* req, uv_work_cb work,
+                       uv_after_work_cb after, Priority priority) {
+  if (workers.empty()) {
+    assert(!options.fifo);
+    uv_queue_work(async.loop, req, work, after);
+    return;
+  }
+
+  if (in_flight++ == 0)
+    uv_ref(reinterpret_cast<uv_handle_t*>(&async));
+
+  size_t index = options.fifo ? static_cast<size_t>(Priority::kNormal)
+                              : static_cast<size_t>(priority);
+  Worker* worker = workers[next++ % workers.size()].get();
+  uv_mutex_lock(&worker->mutex);
+  worker->tasks[index].push_back({ req, work, after });
+  uv_mutex_unlock(&worker->mutex);
+
+  uv_mutex_lock(&mutex);
+  queued++;
+  uv_cond_signal(&wakeup);
+  uv_mutex_unlock(&mutex);
+}
+
+/*
+ * Withdraws a task that no worker has taken yet. Its `after(req, 0)` then
+ * gets called along with the next completions, without `work(req)` having
+ * run. Returns false when a worker got to it first.
+ */
+
+bool WorkerPool::Cancel(uv_work_t* req) {
+  // claim a task like a worker would, so that the workers' count of the
+  // tasks left in the queues stays right
+  uv_mutex_lock(&mutex);
+  bool claimed = queued > 0 && !stopping;
+  if (claimed)
+    queued--;
+  uv_mutex_unlock(&mutex);
+  if (!claimed)
+    return false;
+
+  Task task;
+  bool found = false;
+  for (size_t i = 0; !found && i < workers.size(); i++) {
+    Worker* worker = workers[i].get();
+    uv_mutex_lock(&worker->mutex);
+    for (std::deque<Task>& tasks : worker->tasks) {
+      auto it = std::find_if(tasks.begin(), tasks.end(),
+                             [req](const Task& t) { return t.req == req; });
+      found = it != tasks.end();
+      if (found) {
+        task = *it;
+        tasks.erase(it);
+        break;
+      }
+    }
+    uv_mutex_unlock(&worker->mutex);
+  }
+
+  uv_mutex_lock(&mutex);
+  if (found) {
+    done.push_back(task);
+    uv_async_send(&async);
+  } else {
+    // a worker took it in the meantime, so give the claim back
+    queued++;
+    uv_cond_signal(&wakeup);
+  }
+  uv_mutex_unlock(&mutex);
+  return found;
+}
+
+/*
+ * Takes the next task for the given worker: the one of the highest Priority
+ * there is, the oldest one from its own queue or else the newest one from any
+ * other worker's. So that a steady stream of interactive calls can't starve
+ * the others, 2 out of every 8 takes look at the normal class first, and 1
+ * at the bulk class.
+ */
+
+bool WorkerPool::Take(Worker* self, Task* task) {
+  static const Priority kFirst[8] = {
+    Priority::kInteractive, Priority::kInteractive, Priority::kInteractive,
+    Priority::kNormal, Priority::kInteractive, Priority::kNormal,
+    Priority::kInteractive, Priority::kBulk
+  };
+  size_t first = static_cast<size_t>(kFirst[self->takes++ % 8]);
+  if (TakeFrom(self, first, task))
+    return true;
+  for (size_t priority = 0; priority < kNumPriorities; priority++) {
+    if (priority != first && TakeFrom(self, priority, task))
+      return true;
+  }
+  return false;
+}
+
+bool WorkerPool::TakeFrom(Worker* self, size_t priority, Task* task) {
+  uv_mutex_lock(&self->mutex);
+  std::deque<Task>& own = self->tasks[priority];
+  bool found = !own.empty();
+  if (found) {
+    *task = own.front();
+    own.pop_front();
+  }
+  uv_mutex_unlock(&self->mutex);
+
+  for (size_t i = 1; !found && i < workers.size(); i++) {
+    Worker* victim = workers[(self->index + i) % workers.size()].get();
+    uv_mutex_lock(&victim->mutex);
+    std::deque<Task>& theirs = victim->tasks[priority];
+    found = !theirs.empty();
+    if (found) {
+      *task = theirs.back();
+      theirs.pop_back();
+    }
+    uv_mutex_unlock(&victim->mutex);
+  }
+  return found;
+}
+
+/*
+ * The worker threads' main function.
+ */
+
+void WorkerPool::Run(void* arg) {
+  Worker* self = static_cast<Worker*>(arg);
+  WorkerPool* pool = self->pool;
+
+  // e.g. "ffi-worker-0", cut to the 15 characters Linux allows
+  std::string name =
+      (pool->options.name + "-" + std::to_string(self->index)).substr(0, 15);
+#if defined(__linux__)
+  pthread_setname_np(pthread_self(), name.c_str());
+#elif defined(__APPLE__)
+  pthread_setname_np(name.c_str());
+#endif
+
+  for (;;) {
+    uv_mutex_lock(&pool->mutex);
+    while (pool->queued == 0 && !pool->stopping)
+      uv_cond_wait(&pool->wakeup, &pool->mutex);
+    if (pool->stopping) {
+      uv_mutex_unlock(&pool->mutex);
+      return;
+    }
+    pool->queued--;
+    pool->active++;
+    uv_mutex_unlock(&pool->mutex);
+
+    // there are always at least as many tasks in the queues as there are
+    // workers that claimed one, so this finds one sooner or later
+    Task task;
+    while (!pool->Take(self, &task)) {}
+    task.work(task.req);
+
+    uv_mutex_lock(&pool->mutex);
+    pool->active--;
+    if (!pool->stopping) {
+      pool->done.push_back(task);
+      uv_async_send(&pool->async);
+    }
+    uv_mutex_unlock(&pool->mutex);
+  }
+}
+
+/*
+ * Has `fn(data)` called once the completions that are being delivered right
+ * now are all done. Returns false (and doesn't call it) when this isn't
+ * called from within a completion callback of the pool.
+ */
+
+bool WorkerPool::Defer(void (*fn)(void* data), void* data) {
+  if (!draining)
+    return false;
+  deferred.emplace_back(fn, data);
+  return true;
+}
+
+/*
+ * Runs the completion callbacks of the finished tasks, on the loop thread.
+ *
+ * With the "coalesce" option, they all run within a single callback scope,
+ * so that the microtask queue gets processed once at the end instead of after
+ * every single callback. A callback that throws is reported as an uncaught
+ * exception, without keeping the others from running.
+ */
+
+void WorkerPool::Complete(uv_async_t* handle) {
+  WorkerPool* pool = static_cast<WorkerPool*>(handle->data);
+
+  std::vector<Task> finished;
+  uv_mutex_lock(&pool->mutex);
+  finished.swap(pool->done);
+  uv_mutex_unlock(&pool->mutex);
+  if (finished.empty())
+    return;
+
+  Env env = pool->env;
+  HandleScope scope(env);
+  std::unique_ptr<CallbackScope> callback_scope;
+  if (pool->options.coalesce)
+    callback_scope.reset(new CallbackScope(env, pool->context));
+
+  pool->draining = true;
+  for (const Task& task : finished) {
+    if (--pool->in_flight == 0)
+      uv_unref(reinterpret_cast<uv_handle_t*>(&pool->async));
+    try {
+      task.after(task.req, 0);
+    } catch (const Error& e) {
+      napi_fatal_exception(env, e.Value());
+    }
+  }
+  pool->draining = false;
+
+  std::vector<std::pair<void (*)(void*), void*>> deferred;
+  deferred.swap(pool->deferred);
+  for (const auto& fn : deferred) {
+    try {
+      fn.first(fn.second);
+    } catch (const Error& e) {
+      napi_fatal_exception(env, e.Value());
+    }
+  }
+}
+
+/*
+ * Stops the workers when the environment is torn down. Tasks that haven't
+ * started yet are dropped. A worker can't be joined while it is still running
+ * a foreign call (which might even be waiting for a JS callback to run on the
+ * loop thread that is going away), so in that case the pool is leaked
+ * instead, and the workers exit once their current call returns.
+ */
+
+void WorkerPool::Dispose() {
+  uv_mutex_lock(&mutex);
+  stopping = true;
+  bool running = active > 0;
+  uv_cond_broadcast(&wakeup);
+  uv_mutex_unlock(&mutex);
+
+  if (running) {
+    uv_close(reinterpret_cast<uv_handle_t*>(&async), nullptr);
+    return;
+  }
+
+  for (const std::unique_ptr<Worker>& worker : workers)
+    uv_thread_join(&worker->thread);
+  uv_close(reinterpret_cast<uv_handle_t*>(&async), [](uv_handle_t* handle) {
+    delete static_cast<WorkerPool*>(handle->data);
+  });
+}
+
+WorkerPool::~WorkerPool() {
+  for (const std::unique_ptr<Worker>& worker : workers)
+    uv_mutex_destroy(&worker->mutex);
+  uv_cond_destroy(&wakeup);
+  uv_mutex_destroy(&mutex);
+}
+
+/*
+ * Configures the FFI worker pool. This has to happen before the first
+ * asynchronous call that uses it starts the threads, and before the first
+ * serial executor gets started, as those copy the options (see `Executor()`).
+ *
+ * args[0] - Number - the number of worker threads
+ * args[1] - String - the thread name prefix
+ * args[2] - Number - the threads' stack size in bytes, or 0 for the default
+ * args[3] - Boolean - coalesce the completions (see `Complete()`)
+ */
+
+Value WorkerPool::Configure(const Napi::CallbackInfo& args) {
+  Env env = args.Env();
+  InstanceData* data = InstanceData::Get(env);
+  if (data->pool != nullptr)
+    throw Error::New(env, "the FFI worker pool is already running");
+  if (!data->executors.empty())
+    throw Error::New(env, "serial executors are already running");
+
+  Options& options = data->pool_options;
+  if (args[0].IsNumber())
+    options.size = std::max<uint32_t>(1, args[0].ToNumber().Uint32Value());
+  if (args[1].IsString())
+    options.name = args[1].As<String>().Utf8Value();
+  if (args[2].IsNumber())
+    options.stack_size = args[2].ToNumber().Uint32Value();
+  if (args[3].IsBoolean())
+    options.coalesce = args[3].ToBoolean();
+  return env.Undefined();
+}
+
+WorkerPool* InstanceData::Pool() {
+  if (pool == nullptr)
+    pool = new WorkerPool(env, pool_options);
+  return pool;
+}
+
+/*
+ * Returns the serial executor for the given affinity key: a pool with a
+ * single thread of its own, which runs the calls queued on it one after the
+ * other, in FIFO order regardless of their priorities. It's started on first
+ * use and named after the key. Throws if its thread can't be started.
+ */
+
+WorkerPool* InstanceData::Executor(const std::string& key) {
+  auto it = executors.find(key);
+  if (it != executors.end())
+    return it->second;
+
+  WorkerPool::Options options = pool_options;
+  options.size = 1;
+  options.name = key;
+  options.fifo = true;
+  WorkerPool* executor = new WorkerPool(env, options);
+  // without its thread, there's nothing to run the calls in order on
+  if (!executor->Started()) {
+    executor->Dispose();
+    throw Error::New(env, "could not start the thread of executor \"" +
+                          key + "\"");
+  }
+  executors[key] = executor;
+  return executor;
+}
+
+}  // namespace FFI
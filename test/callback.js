@@ -157,6 +157,108 @@ describe('Callback', function () {
     }
   });
 
+  it('should reuse the closures of collected callbacks', function (done) {
+    // a signature of its own, so no other test's closures get in the way
+    const sig = [ 'int16', [ 'int16', 'int8' ] ];
+    const addresses = new Set();
+    for (let i = 0; i < 10; i++) {
+      addresses.add(ffi.Callback(sig[0], sig[1], function () { return 0; }).address());
+    }
+    global.gc();
+    setImmediate(function () {
+      const cb = ffi.Callback(sig[0], sig[1], function (a, b) { return a * b; });
+      assert(addresses.has(cb.address()));
+      const fn = ffi.ForeignFunction(cb, sig[0], sig[1]);
+      assert.strictEqual(-6, fn(3, -2));
+      done();
+    });
+  });
+
+  describe('native decoding', function () {
+    it('should pass primitive arguments and encode the return value', function () {
+      const cb = ffi.Callback('double', [ 'int8', 'uint16', 'int64', 'float', 'bool', 'string' ],
+        function (a, b, c, d, e, f) {
+          assert.strictEqual(-5, a);
+          assert.strictEqual(65535, b);
+          assert.strictEqual(1099511627776, c);
+          assert.strictEqual(1.5, d);
+          assert.strictEqual(true, e);
+          assert.strictEqual('hi', f);
+          return 0.25;
+        });
+      const fn = ffi.ForeignFunction(cb, 'double',
+        [ 'int8', 'uint16', 'int64', 'float', 'bool', 'string' ]);
+      assert.strictEqual(0.25, fn(-5, 65535, 1099511627776, 1.5, true, 'hi'));
+    });
+
+    it('should widen small integer return values', function () {
+      const cb = ffi.Callback('int8', [ 'int8' ], function (val) {
+        return val - 1;
+      });
+      const fn = ffi.ForeignFunction(cb, 'int32', [ 'int8' ]);
+      assert.strictEqual(-2, fn(-1));
+    });
+
+    it('should sort with a comparator of typed pointers', function () {
+      const libc = new ffi.Library(null, {
+        qsort: [ 'void', [ 'pointer', 'size_t', 'size_t', 'pointer' ] ]
+      });
+      const intPtr = ref.refType(int);
+      const compare = ffi.Callback(int, [ intPtr, intPtr ], function (a, b) {
+        assert.strictEqual(int, a.type);
+        return a.deref() - b.deref();
+      });
+      const values = [ 3, -1, 7, 0, 2 ];
+      const buf = Buffer.alloc(values.length * int.size);
+      values.forEach(function (val, i) {
+        buf.writeInt32LE(val, i * int.size);
+      });
+      libc.qsort(buf, values.length, int.size, compare);
+      const sorted = values.map(function (val, i) {
+        return buf.readInt32LE(i * int.size);
+      });
+      assert.deepStrictEqual([ -1, 0, 2, 3, 7 ], sorted);
+    });
+
+    it('should still call "get()" of a type that overrides it', function () {
+      const doubled = Object.create(int);
+      doubled.get = function (buf, offset) {
+        return int.get(buf, offset) * 2;
+      };
+      const cb = ffi.Callback(int, [ doubled ], function (val) {
+        return val;
+      });
+      const fn = ffi.ForeignFunction(cb, int, [ int ]);
+      assert.strictEqual(42, fn(21));
+    });
+  });
+
+  describe('nonblocking', function () {
+    it('should not make the invoking thread wait for the event loop', function (done) {
+      const lines = [];
+      const log = ffi.Callback('void', [ 'string', 'int32' ], function (line, n) {
+        lines.push([ line, n ]);
+        if (lines.length < 100) return;
+        for (let i = 0; i < 100; i++) {
+          assert.deepStrictEqual([ 'line ' + i, i ], lines[i]);
+        }
+        [ log ].map(() => {});
+        done();
+      }, { nonblocking: true });
+      const logFromThread = ffi.ForeignFunction(bindings.log_from_thread, 'void',
+        [ 'pointer', 'int32' ]);
+      // joins the thread, which would deadlock if it waited for the callbacks
+      logFromThread(log, 100);
+      assert.strictEqual(0, lines.length);
+    });
+
+    it('should only be allowed for void callbacks', function () {
+      assert.throws(function () {
+        ffi.Callback('int', [ 'int' ], Math.abs, { nonblocking: true });
+      }, /must return void/);
+    });
+  });
+
   describe('async', function () {
     it('should be invokable asynchronously by an ffi\'d ForeignFunction', function (done) {
       const funcPtr = ffi.Callback(int, [ int ], Math.abs);
@@ -188,6 +290,30 @@ describe('Callback', function () {
       });
     });
 
+    it('should run callbacks invoked by many threads at once', function (done) {
+      this.timeout(10000);
+      const calls = 16;
+      const counts = [];
+      let pending = calls;
+      for (let i = 0; i < calls; i++) {
+        let iterations = 1000;
+        counts.push(0);
+        const cb = ffi.Callback('string', [ 'string' ], function (val) {
+          counts[i]++;
+          return val === 'ping' && --iterations > 0 ? 'pong' : 'end';
+        });
+        // half of them on the FFI worker pool, half on the libuv threadpool
+        const pingPongFn = ffi.ForeignFunction(bindings.play_ping_pong, 'void',
+          [ 'pointer' ], undefined, { pool: i % 2 ? 'uv' : 'ffi' });
+        pingPongFn.async(cb, function (err) {
+          assert.strictEqual(null, err);
+          assert.strictEqual(1000, counts[i]);
+          [ cb ].map(() => {}); // keep the callback alive until here
+          if (--pending === 0) done();
+        });
+      }
+    });
+
     /**
      * See https://github.com/rbranson/node-ffi/issues/72.
      * This is a tough issue. If we pass the ffi_closure Buffer to some foreign
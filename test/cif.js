@@ -18,6 +18,20 @@ describe('ffi_cif', function () {
     assert(Buffer.isBuffer(cif));
   });
 
+  it('should return the same instance for the same signature', function () {
+    const cif = ffi.CIF('double', [ 'int', 'void *' ]);
+    assert.strictEqual(cif, ffi.CIF(ref.types.double, [ ref.types.int32, 'string' ]));
+    assert.notStrictEqual(cif, ffi.CIF('double', [ 'int', 'double' ]));
+    assert.notStrictEqual(cif, ffi.CIF('float', [ 'int', 'void *' ]));
+  });
+
+  it('should not share instances between variadic splits', function () {
+    const cif = ffi.CIF_var(ref.types.int, [ ref.types.int, ref.types.int ], 1);
+    assert.strictEqual(cif, ffi.CIF_var(ref.types.int, [ ref.types.int, ref.types.int ], 1));
+    assert.notStrictEqual(cif, ffi.CIF_var(ref.types.int, [ ref.types.int, ref.types.int ], 2));
+    assert.notStrictEqual(cif, ffi.CIF(ref.types.int, [ ref.types.int, ref.types.int ]));
+  });
+
   it('should throw an Error when given an invalid "type"', function () {
     const ffi_type = new ffi.FFI_TYPE;
     ffi_type.size = 0;
@@ -47,3 +61,39 @@ describe('ffi_cif', function () {
     });
   });
 });
+
+describe('interned ffi_cif', function () {
+  before(function () {
+    if (typeof WeakRef !== 'function') this.skip();
+  });
+
+  it('should let go of the cifs that nothing uses anymore', function (done) {
+    const Struct = require('ref-struct-di')(ref);
+    const point = Struct({ x: 'int', y: 'int' });
+    const cif = new WeakRef(ffi.CIF('int', [ point ]));
+    setImmediate(function () {
+      global.gc();
+      assert.strictEqual(undefined, cif.deref());
+      done();
+    });
+  });
+
+  it('should not reuse the closures of a collected cif', function (done) {
+    const Struct = require('ref-struct-di')(ref);
+    const point = Struct({ x: 'int', y: 'int' });
+    function sum (p) {
+      return p.x + p.y;
+    }
+    ffi.Callback('int', [ point ], sum);
+    setImmediate(function () {
+      global.gc();
+      setImmediate(function () {
+        global.gc();
+        const cb = ffi.Callback('int', [ point ], sum);
+        const fn = ffi.ForeignFunction(cb, 'int', [ point ]);
+        assert.strictEqual(5, fn(new point({ x: 2, y: 3 })));
+        done();
+      });
+    });
+  });
+});
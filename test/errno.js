@@ -2,6 +2,7 @@
 const assert = require('assert');
 const ref = require('ref-napi');
 const ffi = require('../');
+const bindings = require('node-gyp-build')(__dirname);
 const errno = ffi.errno;
 
 describe('errno()', function () {
@@ -20,3 +21,80 @@ describe('errno()', function () {
     assert.strictEqual(34, errno()); // errno == ERANGE
   });
 });
+
+describe('errno capture', function () {
+  afterEach(global.gc);
+
+  const lib = process.platform == 'win32' ? 'msvcrt' : 'libc';
+  const ENOENT = 2;
+
+  it('should capture the errno right after the call', function () {
+    const strtoul = new ffi.Library(lib, {
+      'strtoul': [ 'ulong', [ 'string', 'string', 'int' ], { errno: true } ]
+    }).strtoul;
+    strtoul('1234567890123456789012345678901234567890', null, 0);
+    assert.strictEqual(34, ffi.lastErrno()); // errno == ERANGE
+    strtoul('1234', null, 0);
+    assert.strictEqual(0, ffi.lastErrno());
+  });
+
+  it('should capture the errno of a ForeignFunction', function () {
+    const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+      { errno: true });
+    fail(ENOENT);
+    assert.strictEqual(ENOENT, ffi.lastErrno());
+  });
+
+  it('should throw an Error when the "negative" policy is violated', function () {
+    const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+      { errorPolicy: 'negative', name: 'fail_with_errno' });
+    assert.strictEqual(0, fail(0));
+    assert.throws(function () {
+      fail(ENOENT);
+    }, function (err) {
+      assert.strictEqual(ENOENT, err.errno);
+      assert.strictEqual('fail_with_errno', err.syscall);
+      if (process.platform != 'win32') {
+        assert.strictEqual('ENOENT', err.code);
+      }
+      return true;
+    });
+  });
+
+  it('should apply the "zero" policy to pointer return values', function () {
+    const getenv = new ffi.Library(lib, {
+      'getenv': [ 'void *', [ 'string' ], { errorPolicy: 'zero' } ]
+    }).getenv;
+    assert.throws(function () {
+      getenv('FFI_NAPI_SURELY_NOT_SET');
+    }, /getenv/);
+  });
+
+  it('should reject unknown policies', function () {
+    assert.throws(function () {
+      ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+        { errorPolicy: 'sometimes' });
+    }, /errorPolicy/);
+  });
+
+  it('should pass the errno to async callbacks', function (done) {
+    const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+      { errno: true });
+    fail.async(ENOENT, function (err, res, errnum) {
+      assert.ifError(err);
+      assert.strictEqual(-1, res);
+      assert.strictEqual(ENOENT, errnum);
+      done();
+    });
+  });
+
+  it('should pass policy errors to async callbacks', function (done) {
+    const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+      { errorPolicy: 'negative' });
+    fail.async(ENOENT, function (err) {
+      assert(err instanceof Error);
+      assert.strictEqual(ENOENT, err.errno);
+      done();
+    });
+  });
+});
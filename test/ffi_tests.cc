@@ -1,9 +1,14 @@
+#include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
 #include <napi.h>
 #include <uv.h>
 #include <get-uv-event-loop-napi.h>
+#ifndef _WIN32
+#include <unistd.h>
+#endif
 
 using namespace Napi;
 
@@ -247,6 +252,113 @@ int test_ref_56(struct Obj56 *obj) {
 }
 
 
+// Invokes the callback in between receiving and returning `str`, so that
+// reentrant calls of the same ForeignFunction can be tested.
+const char* call_and_return(const char* str, void (*cb)(void)) {
+  cb();
+  return str;
+}
+
+// Interleaves integer and floating point arguments of different widths.
+double mixed_args(int8_t a, double b, uint16_t c, float d, int64_t e, double f) {
+  return a + b + c + d + e + f;
+}
+
+float scale_float(float x, int32_t factor) {
+  return x * factor;
+}
+
+// More floating point arguments than there are registers for them, mixed with
+// small structs that are passed in registers too while there is room.
+typedef struct _point {
+  double x;
+  double y;
+} point;
+
+double weigh_points(point a, double wa, point b, double wb, point c, double wc,
+                    point d, double wd, int8_t shift, point e, double we) {
+  return (a.x + a.y) * wa + (b.x + b.y) * wb + (c.x + c.y) * wc +
+      (d.x + d.y) * wd + (e.x + e.y) * we + shift;
+}
+
+point mid_point(point a, point b) {
+  point m = { (a.x + b.x) / 2, (a.y + b.y) / 2 };
+  return m;
+}
+
+int64_t box_volume(box b, int64_t depth) {
+  return b.width * b.height * depth;
+}
+
+int64_t add_int64(int64_t a, int64_t b) {
+  return a + b;
+}
+
+double sum_ten(double a, double b, double c, double d, double e,
+               double f, double g, double h, double i, int64_t j) {
+  return a + b + c + d + e + f + g + h + i + j;
+}
+
+uint64_t thread_id() {
+#ifdef _WIN32
+  return GetCurrentThreadId();
+#else
+  return (uint64_t) (uintptr_t) pthread_self();
+#endif
+}
+
+int fail_with_errno(int err) {
+  errno = err;
+  return err == 0 ? 0 : -1;
+}
+
+// Holds up the worker thread that calls `latch_wait()` until the test calls
+// `latch_release()`.
+static uv_sem_t latch;
+
+void latch_wait(void) {
+  uv_sem_wait(&latch);
+}
+
+void latch_release(void) {
+  uv_sem_post(&latch);
+}
+
+uint32_t sleep_ms(uint32_t ms) {
+#ifdef _WIN32
+  Sleep(ms);
+#else
+  usleep(ms * 1000);
+#endif
+  return ms;
+}
+
+// Calls `log(line, n)` `count` times from a thread of its own, reusing the
+// line's storage for every call, and waits for that thread to finish. Only
+// works with callbacks that don't wait for the event loop.
+typedef void (*log_cb)(const char* line, int32_t n);
+
+struct log_args {
+  log_cb log;
+  int32_t count;
+};
+
+void log_from_thread(log_cb log, int32_t count) {
+  log_args args = { log, count };
+  uv_thread_t tid;
+  uv_thread_create(&tid, [](void* data) {
+    log_args* args = static_cast<log_args*>(data);
+    char line[32];
+    for (int32_t n = 0; n < args->count; n++) {
+      snprintf(line, sizeof(line), "line %d", n);
+      args->log(line, n);
+    }
+    memset(line, 0, sizeof(line));
+  }, &args);
+  uv_thread_join(&tid);
+}
+
+
 /*
  * Converts an arbitrary pointer to a node Buffer (with 0-length)
  */
@@ -294,6 +406,21 @@ Object Initialize(Env env, Object exports) {
   exports["play_ping_pong"] = WrapPointer(env, play_ping_pong);
   exports["test_169"] = WrapPointer(env, test_169);
   exports["test_ref_56"] = WrapPointer(env, test_ref_56);
+  exports["call_and_return"] = WrapPointer(env, call_and_return);
+  exports["mixed_args"] = WrapPointer(env, mixed_args);
+  exports["scale_float"] = WrapPointer(env, scale_float);
+  exports["weigh_points"] = WrapPointer(env, weigh_points);
+  exports["mid_point"] = WrapPointer(env, mid_point);
+  exports["sum_ten"] = WrapPointer(env, sum_ten);
+  exports["box_volume"] = WrapPointer(env, box_volume);
+  exports["add_int64"] = WrapPointer(env, add_int64);
+  exports["fail_with_errno"] = WrapPointer(env, fail_with_errno);
+  exports["thread_id"] = WrapPointer(env, thread_id);
+  exports["sleep_ms"] = WrapPointer(env, sleep_ms);
+  exports["log_from_thread"] = WrapPointer(env, log_from_thread);
+  uv_sem_init(&latch, 0);
+  exports["latch_wait"] = WrapPointer(env, latch_wait);
+  exports["latch_release"] = WrapPointer(env, latch_release);
 
   return exports;
 }
@@ -180,6 +180,201 @@ describe('ForeignFunction', function () {
     void_ptr_arg(b);
   });
 
+  it('should accept BigInt values for integer arguments', function () {
+    const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+    assert.strictEqual(1234, abs(-1234n));
+  });
+
+  it('should pass "string" arguments and return values through', function () {
+    // `callback_func()` returns its argument unchanged
+    const identity = ffi.ForeignFunction(bindings.callback_func, 'string', [ 'string' ]);
+    assert.strictEqual('hello world', identity('hello world'));
+    assert.strictEqual(null, identity(null));
+  });
+
+  it('should support reentrant calls from a callback', function () {
+    const call_and_return = ffi.ForeignFunction(bindings.call_and_return, 'string', [ 'string', 'void *' ]);
+    const noop = ffi.Callback('void', [ ], function () { });
+    let inner;
+    const cb = ffi.Callback('void', [ ], function () {
+      inner = call_and_return('inner', noop);
+    });
+    assert.strictEqual('outer', call_and_return('outer', cb));
+    assert.strictEqual('inner', inner);
+  });
+
+  it('should throw an Error with a meaningful message for a non-Buffer pointer argument', function () {
+    const void_ptr_arg = ffi.ForeignFunction(bindings.abs, 'void *', [ 'void *' ]);
+    assert.throws(function () {
+      void_ptr_arg(42);
+    }, /error setting argument 1/);
+  });
+
+  it('should interleave integer and floating point arguments', function () {
+    const mixed_args = ffi.ForeignFunction(bindings.mixed_args, 'double',
+        [ 'int8', 'double', 'uint16', 'float', 'int64', 'double' ]);
+    assert.strictEqual(-1 + 0.5 + 65535 + 0.25 - 4 + 0.125, mixed_args(-1, 0.5, 65535, 0.25, -4, 0.125));
+    const scale_float = ffi.ForeignFunction(bindings.scale_float, 'float', [ 'float', 'int32' ]);
+    assert.strictEqual(-7.5, scale_float(2.5, -3));
+  });
+
+  it('should take a char as an 8-bit integer argument', function (done) {
+    const mixed_args = ffi.ForeignFunction(bindings.mixed_args, 'double',
+        [ 'int8', 'double', 'uint16', 'float', 'int64', 'double' ]);
+    assert.strictEqual(65, mixed_args('A', 0, 0, 0, 0, 0));
+    assert.strictEqual(0, mixed_args('', 0, 0, 0, 0, 0));
+    assert.throws(function () {
+      mixed_args('\u00e9', 0, 0, 0, 0, 0);
+    }, /error setting argument 1 - value is out of range for int8/);
+    mixed_args.async('a', 0, 0, 0, 0, 0, function (err, res) {
+      assert.strictEqual(null, err);
+      assert.strictEqual(97, res);
+      done();
+    });
+  });
+
+  it('should report the path a function is called through', function () {
+    const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+    const direct = [ 'x64', 'arm64' ].includes(process.arch) && process.platform !== 'win32';
+    assert.strictEqual(direct ? 'thunk' : 'libffi', abs.callPath);
+    const area_box = ffi.ForeignFunction(bindings.area_box, 'int', [ box ]);
+    assert.strictEqual('js', area_box.callPath);
+  });
+
+  describe('call stubs', function () {
+    const point = Struct({
+      x: 'double',
+      y: 'double'
+    });
+    const stubs = process.arch === 'x64' && process.platform !== 'win32';
+
+    it('should pass structs and doubles beyond the argument registers', function () {
+      const weigh_points = ffi.ForeignFunction(bindings.weigh_points, 'double',
+          [ point, 'double', point, 'double', point, 'double', point, 'double', 'int8', point, 'double' ]);
+      const p = (x, y) => new point({ x, y });
+      const res = weigh_points(p(1, 2), 0.5, p(3, 4), 2, p(5, 6), 0.25, p(7, 8), 4, -3, p(9, 10), 0.125);
+      assert.strictEqual(1.5 + 14 + 2.75 + 60 + 2.375 - 3, res);
+    });
+
+    it('should return structs in registers', function () {
+      const mid_point = ffi.ForeignFunction(bindings.mid_point, point, [ point, point ]);
+      const m = mid_point(new point({ x: 1, y: -2 }), new point({ x: 4, y: 6 }));
+      assert.strictEqual(2.5, m.x);
+      assert.strictEqual(2, m.y);
+    });
+
+    it('should be used when a signature has no thunk', function () {
+      const sum_ten = ffi.ForeignFunction(bindings.sum_ten, 'double',
+          [ 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'int64' ]);
+      assert.strictEqual(stubs ? 'jit' : 'libffi', sum_ten.callPath);
+      assert.strictEqual(55, sum_ten(1, 2, 3, 4, 5, 6, 7, 8, 9, 10));
+    });
+  });
+
+  describe('64-bit return values', function () {
+    const big = '9007199254740993';
+
+    it('should be Numbers when safe and Strings otherwise', function () {
+      const add_int64 = ffi.ForeignFunction(bindings.add_int64, 'int64', [ 'int64', 'int64' ]);
+      assert.strictEqual(3, add_int64(1, 2));
+      assert.strictEqual(big, add_int64(big, 0));
+      const box_volume = ffi.ForeignFunction(bindings.box_volume, 'int64', [ box, 'int64' ]);
+      assert.strictEqual(big, box_volume(new box({ width: 1, height: 1 }), big));
+    });
+
+    it('should be BigInts with the "bigint" option', function () {
+      const options = { bigint: true };
+      const add_int64 = ffi.ForeignFunction(bindings.add_int64, 'int64', [ 'int64', 'int64' ], undefined, options);
+      assert.strictEqual(3n, add_int64(1, 2));
+      assert.strictEqual(BigInt(big), add_int64(big, 0));
+      const box_volume = ffi.ForeignFunction(bindings.box_volume, 'int64', [ box, 'int64' ], undefined, options);
+      assert.strictEqual(-24n, box_volume(new box({ width: 2, height: 3 }), -4));
+    });
+
+    it('should be BigInts with the "bigint" option when called asynchronously', function (done) {
+      const box_volume = ffi.ForeignFunction(bindings.box_volume, 'int64', [ box, 'int64' ], undefined, { bigint: true });
+      box_volume.async(new box({ width: 2, height: 3 }), 4, function (err, res) {
+        assert.ifError(err);
+        assert.strictEqual(24n, res);
+        done();
+      });
+    });
+  });
+
+  describe('batch', function () {
+    it('should call the function once per argument tuple', function () {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      const res = abs.batch([ [ -1 ], [ 2 ], [ -3 ] ]);
+      assert(res instanceof Int32Array);
+      assert.deepStrictEqual([ 1, 2, 3 ], Array.from(res));
+    });
+
+    it('should accept the arguments in a flat TypedArray', function () {
+      const scale_float = ffi.ForeignFunction(bindings.scale_float, 'float', [ 'float', 'int32' ]);
+      const res = scale_float.batch(new Float64Array([ 1.5, 2, 2.5, -3 ]));
+      assert(res instanceof Float32Array);
+      assert.deepStrictEqual([ 3, -7.5 ], Array.from(res));
+      assert.throws(function () {
+        scale_float.batch(new Float64Array(3));
+      }, /expected a multiple of 2 values, got 3/);
+    });
+
+    it('should return strings in an Array', function () {
+      const identity = ffi.ForeignFunction(bindings.callback_func, 'string', [ 'string' ]);
+      assert.deepStrictEqual([ 'a', null ], identity.batch([ [ 'a' ], [ null ] ]));
+    });
+
+    it('should report which call failed', function () {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      assert.throws(function () {
+        abs.batch([ [ 1 ], [ 1, 2 ] ]);
+      }, /call 2 - expected 1 arguments, got 2/);
+      const void_ptr_arg = ffi.ForeignFunction(bindings.abs, 'void *', [ 'void *' ]);
+      assert.throws(function () {
+        void_ptr_arg.batch([ [ null ], [ 42 ] ]);
+      }, /call 2 - error setting argument 1/);
+    });
+
+    it('should also work for functions with JS marshalling', function () {
+      const area_box = ffi.ForeignFunction(bindings.area_box, 'int', [ box ]);
+      const res = area_box.batch([ [ new box({ width: 2, height: 3 }) ], [ new box({ width: 4, height: 5 }) ] ]);
+      assert.deepStrictEqual([ 6, 20 ], res);
+    });
+  });
+
+  describe('map', function () {
+    it('should apply the function over TypedArray columns', function () {
+      const scale_float = ffi.ForeignFunction(bindings.scale_float, 'float', [ 'float', 'int32' ]);
+      const out = new Float32Array(3);
+      const res = scale_float.map(out, new Float32Array([ 0.5, 1.5, -2 ]), new Int8Array([ 2, -2, 3 ]));
+      assert.strictEqual(out, res);
+      assert.deepStrictEqual([ 1, -3, -6 ], Array.from(out));
+    });
+
+    it('should pass scalar arguments to every call', function () {
+      const sum_ten = ffi.ForeignFunction(bindings.sum_ten, 'double',
+          [ 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'double', 'int64' ]);
+      const out = sum_ten.map(new Float64Array(2), 1, 1, 1, 1, 1, 1, 1, 1, new Float64Array([ 1, 2 ]), 10n);
+      assert.deepStrictEqual([ 19, 20 ], Array.from(out));
+    });
+
+    it('should check the element types, lengths and values', function () {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      assert.throws(function () {
+        abs.map(new Float64Array(1), new Int32Array(1));
+      }, /expected a TypedArray of int32 for the results/);
+      assert.throws(function () {
+        abs.map(new Int32Array(2), new Int32Array(1));
+      }, /argument 1 has 1 elements, expected 2/);
+      assert.throws(function () {
+        abs.map(new Int32Array(2), new Float64Array([ 1, 2 ** 40 ]));
+      }, /element 1 - error setting argument 1 - value is out of range for int32/);
+      assert.throws(function () {
+        ffi.ForeignFunction(bindings.callback_func, 'string', [ 'string' ]).map(null, 'a');
+      }, /requires number or bool argument types/);
+    });
+  });
+
   describe('async', function () {
     it('should call the static "abs" bindings asynchronously', function (done) {
       const _abs = bindings.abs;
@@ -211,5 +406,431 @@ describe('ForeignFunction', function () {
         }
       });
     });
+
+    it('should complete many concurrent calls on the FFI worker pool', function (done) {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      let pending = 100;
+      for (let i = 0; i < 100; i++) {
+        abs.async(-i, function (err, res) {
+          assert.strictEqual(null, err);
+          assert.strictEqual(i, res);
+          if (--pending === 0) done();
+        });
+      }
+    });
+
+    it('should run calls on the libuv threadpool with `pool: \'uv\'`', function (done) {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+        { pool: 'uv' });
+      abs.async(-1234, function (err, res) {
+        assert.strictEqual(null, err);
+        assert.strictEqual(1234, res);
+        done();
+      });
+    });
+
+    it('should reject unknown pools', function () {
+      assert.throws(function () {
+        ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+          { pool: 'other' });
+      }, /pool/);
+    });
+
+    it('should be the CallPlan\'s own `async()` for native types', function (done) {
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      assert.strictEqual('async', abs.async.name);
+      let pending = 3;
+      [ -1, -2, -3 ].forEach(function (val) {
+        abs.async(val, function (err, res) {
+          assert.strictEqual(null, err);
+          assert.strictEqual(-val, res);
+          if (--pending === 0) done();
+        });
+      });
+    });
+
+    it('should keep string arguments alive for `async()` calls', function (done) {
+      const lib = process.platform == 'win32' ? 'msvcrt' : null;
+      const strlen = ffi.Library(lib, {
+        'strlen': [ 'size_t', [ 'string' ] ]
+      }).strlen;
+      strlen.async('hello' + ' world', function (err, res) {
+        assert.strictEqual(null, err);
+        assert.strictEqual(11, res);
+        done();
+      });
+      global.gc();
+    });
+
+    it('should keep working after the proxy function itself got collected', function (done) {
+      let abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      const async = abs.async;
+      abs = null;
+      global.gc();
+      async(-42, function (err, res) {
+        assert.strictEqual(null, err);
+        assert.strictEqual(42, res);
+        done();
+      });
+    });
+
+    it('should deliver completions in batches to a `completionHandler`', function (done) {
+      const results = new Map();
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined, {
+        completionHandler: function (completions) {
+          assert.strictEqual(0, completions.length % 3);
+          for (let i = 0; i < completions.length; i += 3) {
+            assert.strictEqual(null, completions[i + 1]);
+            results.set(completions[i], completions[i + 2]);
+          }
+          if (results.size === 50) {
+            for (let tag = 0; tag < 50; tag++) {
+              assert.strictEqual(tag, results.get(tag));
+            }
+            done();
+          }
+        }
+      });
+      for (let tag = 0; tag < 50; tag++) {
+        abs.async(-tag, tag);
+      }
+    });
+
+    it('should require CallPlan types for a `completionHandler`', function () {
+      const box = Struct({ width: ref.types.int, height: ref.types.int });
+      assert.throws(function () {
+        ffi.ForeignFunction(bindings.area_box, 'int', [ box ], undefined, {
+          completionHandler: function () {}
+        });
+      }, /completionHandler/);
+    });
+
+    it('should run calls with the same `executor` on one thread, in order', function (done) {
+      const a = ffi.ForeignFunction(bindings.thread_id, 'uint64', [], undefined,
+        { executor: 'test-serial' });
+      const b = ffi.ForeignFunction(bindings.thread_id, 'uint64', [], undefined,
+        { executor: 'test-serial' });
+      const other = ffi.ForeignFunction(bindings.thread_id, 'uint64', [], undefined,
+        { executor: 'test-other' });
+      const order = [];
+      const threads = new Set();
+      let pending = 20;
+      for (let i = 0; i < 20; i++) {
+        (i % 2 ? a : b).async(function (err, res) {
+          assert.strictEqual(null, err);
+          order.push(i);
+          threads.add(String(res));
+          if (--pending > 0) return;
+          assert.deepStrictEqual(Array.from(order.keys()), order);
+          assert.strictEqual(1, threads.size);
+          other.async(function (err, res) {
+            assert.strictEqual(null, err);
+            assert(!threads.has(String(res)));
+            done();
+          });
+        });
+      }
+    });
+
+    describe('promises', function () {
+      const { AsyncLocalStorage } = require('async_hooks');
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+
+      it('should return a Promise without a callback', function () {
+        return abs.async(-1234).then(function (res) {
+          assert.strictEqual(1234, res);
+          return abs.async(-5, { priority: 'interactive' });
+        }).then(function (res) {
+          assert.strictEqual(5, res);
+        });
+      });
+
+      it('should reject calls that fail their error policy', function () {
+        const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+          { errorPolicy: 'negative', name: 'fail_with_errno' });
+        const ENOENT = require('os').constants.errno.ENOENT;
+        return fail.async(ENOENT).then(function () {
+          assert.fail('expected a rejection');
+        }, function (err) {
+          assert(err instanceof Error);
+          assert.strictEqual(ENOENT, err.errno);
+        });
+      });
+
+      it('should return Promises from functions with types converted in JS', function () {
+        const area = ffi.ForeignFunction(bindings.area_box, ref.types.int, [ box ]);
+        const b = new box({ width: 5, height: 20 });
+        return area.async(b, {}).then(function (res) {
+          assert.strictEqual(100, res);
+        });
+      });
+
+      it('should return Promises from chains', function () {
+        const run = ffi.chain([ [ abs, [ ffi.chain.input(0) ] ] ]);
+        return run(-3).then(function (results) {
+          assert.deepStrictEqual([ 3 ], results);
+        });
+      });
+
+      it('should keep the async context of the call', function () {
+        const als = new AsyncLocalStorage();
+        const area = ffi.ForeignFunction(bindings.area_box, ref.types.int, [ box ]);
+        const uvAbs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+          { pool: 'uv' });
+        const calls = [
+          (cb) => abs.async(-1, cb),
+          (cb) => uvAbs.async(-1, cb),
+          (cb) => area.async(new box({ width: 1, height: 1 }), cb)
+        ];
+        return Promise.all(calls.map(function (call, i) {
+          return als.run({ id: i }, function () {
+            return new Promise(function (resolve) {
+              call(function (err) {
+                assert.strictEqual(null, err);
+                assert.deepStrictEqual({ id: i }, als.getStore());
+                resolve();
+              });
+            }).then(function () {
+              return call(undefined);
+            }).then(function () {
+              assert.deepStrictEqual({ id: i }, als.getStore());
+            });
+          });
+        }));
+      });
+    });
+
+    describe('cancellation', function () {
+      before(function () {
+        if (typeof AbortController === 'undefined') this.skip();
+      });
+
+      // keeps the executor's thread busy, so that the calls behind it queue up
+      const sleep = ffi.ForeignFunction(bindings.sleep_ms, 'uint32', [ 'uint32' ], undefined,
+        { executor: 'test-cancel' });
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+        { executor: 'test-cancel' });
+      const area = ffi.ForeignFunction(bindings.area_box,
+        'int', [ Struct({ width: 'int', height: 'int' }) ], undefined,
+        { executor: 'test-cancel' });
+
+      it('should drop queued calls when their signal aborts', function (done) {
+        const controller = new AbortController();
+        let slept = false;
+        sleep.async(100, function (err) {
+          assert.strictEqual(null, err);
+          slept = true;
+        });
+        abs.async(-1, function (err, res) {
+          assert.strictEqual('AbortError', err.name);
+          assert.strictEqual('ABORT_ERR', err.code);
+          assert.strictEqual(controller.signal.reason, err.cause);
+          assert.strictEqual(undefined, res);
+          // withdrawn from the queue, not run after the blocking call
+          assert(!slept);
+          done();
+        }, { signal: controller.signal });
+        controller.abort('stale');
+      });
+
+      it('should not run calls whose signal already aborted', function (done) {
+        const controller = new AbortController();
+        controller.abort();
+        abs.async(-1, function (err) {
+          assert.strictEqual('ABORT_ERR', err.code);
+          done();
+        }, { signal: controller.signal });
+      });
+
+      it('should drop calls that are still queued past their timeout', function (done) {
+        sleep.async(50, function () {});
+        abs.async(-1, function (err) {
+          assert.strictEqual('ERR_FFI_DEADLINE_EXCEEDED', err.code);
+          abs.async(-1, function (err, res) {
+            assert.strictEqual(null, err);
+            assert.strictEqual(1, res);
+            done();
+          }, { timeout: 1000 });
+        }, { timeout: 10 });
+      });
+
+      it('should also withdraw calls with JS marshalling', function (done) {
+        const controller = new AbortController();
+        sleep.async(50, function () {});
+        area.async({ width: 2, height: 3 }, function (err) {
+          assert.strictEqual('ABORT_ERR', err.code);
+          done();
+        }, { signal: controller.signal });
+        controller.abort();
+      });
+
+      it('should validate the call options', function () {
+        assert.throws(function () {
+          abs.async(-1, function () {}, { timeout: -1 });
+        }, /timeout/);
+        assert.throws(function () {
+          abs.async(-1, function () {}, { signal: {} });
+        }, /AbortSignal/);
+        assert.throws(function () {
+          abs.async(-1, function () {}, { signal: { addEventListener: function () {} } });
+        }, /AbortSignal/);
+      });
+
+      it('should ignore a signal that aborts after the call is done', function (done) {
+        // keeps its listeners regardless
+        const listeners = [];
+        const signal = {
+          aborted: false,
+          addEventListener: function (type, listener) {
+            listeners.push(listener);
+          },
+          removeEventListener: function () {}
+        };
+        abs.async(-1, function (err, res) {
+          assert.strictEqual(null, err);
+          assert.strictEqual(1, res);
+          setImmediate(function () {
+            // the next call likely reuses the request of the first one
+            sleep.async(20, function () {});
+            abs.async(-2, function (err, res) {
+              assert.strictEqual(null, err);
+              assert.strictEqual(2, res);
+              done();
+            });
+            listeners.forEach(function (listener) {
+              listener();
+            });
+          });
+        }, { signal: signal });
+      });
+    });
+
+    it('should run interactive calls ahead of queued normal calls', function () {
+      this.timeout(10000);
+      // in a process of its own, for a pool of a single worker, which is held
+      // up by the latch until all the calls have been queued
+      const script = `
+        const ffi = require(${JSON.stringify(require('path').join(__dirname, '..'))});
+        const bindings = require('node-gyp-build')(${JSON.stringify(__dirname)});
+        ffi.configurePool({ size: 1 });
+        const latch = ffi.ForeignFunction(bindings.latch_wait, 'void', []);
+        const release = ffi.ForeignFunction(bindings.latch_release, 'void', []);
+        const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+        const order = [];
+        latch.async(function () {});
+        for (let i = 0; i < 8; i++) {
+          abs.async(-i, function (err, res) { order.push(res); });
+        }
+        abs.async(-100, function (err, res) { order.push(res); },
+          { priority: 'interactive' });
+        release();
+        process.on('exit', function () { console.log(JSON.stringify(order)); });
+      `;
+      const out = require('child_process').execFileSync(process.execPath, [ '-e', script ]);
+      // the worker takes an interactive task first, whether it had taken the
+      // latch's task before or not, then the others in FIFO order
+      assert.deepStrictEqual([ 100, 0, 1, 2, 3, 4, 5, 6, 7 ], JSON.parse(out));
+    });
+
+    it('should reject unknown priorities', function () {
+      assert.throws(function () {
+        ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined, { priority: 'urgent' });
+      }, /priority/);
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      assert.throws(function () {
+        abs.async(-1, function () {}, { priority: 'urgent' });
+      }, /priority must be one of/);
+    });
+
+    it('should not reconfigure the worker pool once it is running', function () {
+      assert.throws(function () {
+        ffi.configurePool({ size: 0 });
+      }, /size/);
+      // makes sure the pool is running, whichever tests ran before
+      const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+      return abs.async(-1).then(function () {
+        assert.throws(function () {
+          ffi.configurePool({ size: 2 });
+        }, /already running/);
+      });
+    });
+  });
+
+  describe('chain', function () {
+    const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+    const add = ffi.ForeignFunction(bindings.add_int64, 'int64', [ 'int64', 'int64' ]);
+
+    it('should pass inputs, constants and results between the steps', function (done) {
+      const run = ffi.chain([
+        [ add, [ ffi.chain.input(0), 10 ] ],
+        [ add, [ ffi.chain.result(0), ffi.chain.input(1) ] ],
+        [ abs, [ -5 ] ]
+      ]);
+      run(1, -100, function (err, results) {
+        assert.strictEqual(null, err);
+        assert.deepStrictEqual([ 11, -89, 5 ], results);
+        done();
+      });
+    });
+
+    it('should stop at the first step that fails its error policy', function (done) {
+      const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+        { errorPolicy: 'negative', name: 'fail_with_errno' });
+      const ENOENT = require('os').constants.errno.ENOENT;
+      const run = ffi.chain([
+        [ fail, [ 0 ] ],
+        [ fail, [ ffi.chain.input(0) ] ],
+        [ abs, [ -1 ] ]
+      ]);
+      run(ENOENT, function (err, results) {
+        assert(err instanceof Error);
+        assert(/step 1/.test(err.message));
+        assert.strictEqual(1, err.step);
+        assert.strictEqual(ENOENT, err.errno);
+        assert.deepStrictEqual([ 0, -1 ], err.results);
+        assert.strictEqual(undefined, results);
+        done();
+      });
+    });
+
+    it('should report input conversion errors to the callback', function (done) {
+      const run = ffi.chain([ [ abs, [ ffi.chain.input(0) ] ] ]);
+      run(Math.pow(2, 40), function (err) {
+        assert(/error setting argument 0 - value is out of range for int32/.test(err.message));
+        done();
+      });
+    });
+
+    it('should check the steps when the chain is created', function () {
+      assert.throws(function () {
+        ffi.chain([ [ abs, [ ffi.chain.result(0) ] ] ]);
+      }, /step 0 .* doesn't run before it/);
+      assert.throws(function () {
+        ffi.chain([ [ abs, [ 1 ] ], [ add, [ ffi.chain.result(0), 1 ] ] ]);
+      }, /argument 1 \(int64\) can't take the result of step 0 \(int32\)/);
+      assert.throws(function () {
+        ffi.chain([ [ abs, [ ffi.chain.input(1) ] ] ]);
+      }, /input 0 is never used/);
+      assert.throws(function () {
+        ffi.chain([ [ abs, [] ] ]);
+      }, /expected 1 arguments/);
+    });
+
+    it('should only chain functions of the same executor and limiter', function () {
+      const serial = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+        { executor: 'test-chain' });
+      const limited = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+        { limiter: new ffi.Limiter({ maxInFlight: 1 }) });
+      assert.throws(function () {
+        ffi.chain([ [ abs, [ -1 ] ], [ serial, [ ffi.chain.result(0) ] ] ]);
+      }, function (err) {
+        return err instanceof TypeError &&
+          /step 1 - .* another pool or executor/.test(err.message);
+      });
+      assert.throws(function () {
+        ffi.chain([ [ abs, [ -1 ] ], [ abs, [ 2 ] ], [ limited, [ 3 ] ] ]);
+      }, /step 2 - .* another limiter/);
+      ffi.chain([ [ serial, [ -1 ] ], [ serial, [ ffi.chain.result(0) ] ] ]);
+    });
   });
 });
@@ -84,6 +84,32 @@ describe('Library', function () {
     }
   })
 
+  describe('lazy', function () {
+    const lib = process.platform == 'win32' ? 'msvcrt' : 'libm';
+
+    it('should bind functions on first access', function () {
+      const libm = new Library(lib, {
+        'ceil': [ 'double', [ 'double' ] ],
+        'floor': [ 'double', [ 'double' ] ]
+      }, null, { lazy: true });
+      assert.deepStrictEqual([ 'ceil', 'floor' ], Object.keys(libm));
+      assert.strictEqual('function', typeof Object.getOwnPropertyDescriptor(libm, 'ceil').get);
+      assert(libm.ceil(1.1) === 2);
+      assert.strictEqual('function', typeof Object.getOwnPropertyDescriptor(libm, 'ceil').value);
+      assert.strictEqual(libm.ceil, libm.ceil);
+      assert.strictEqual('function', typeof Object.getOwnPropertyDescriptor(libm, 'floor').get);
+    });
+
+    it('should only throw for an invalid function name when it is accessed', function () {
+      const funcs = new Library(null, {
+        'doesnotexist__': [ 'void', [] ]
+      }, null, { lazy: true });
+      assert.throws(function () {
+        funcs.doesnotexist__();
+      }, /Dynamic Symbol Retrieval Error/);
+    });
+  });
+
   it('should work with "strcpy" and a 128 length string', function () {
     const lib = process.platform == 'win32' ? 'msvcrt.dll' : null;
     const ZEROS_128 = Array(128 + 1).join('0');
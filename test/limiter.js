@@ -0,0 +1,124 @@
+'use strict';
+const assert = require('assert');
+const ref = require('ref-napi');
+const ffi = require('../');
+const bindings = require('node-gyp-build')(__dirname);
+
+describe('Limiter', function () {
+  afterEach(global.gc);
+
+  function sleeper (limiter) {
+    return ffi.ForeignFunction(bindings.sleep_ms, 'uint32', [ 'uint32' ], undefined,
+      { executor: 'test-limits', limiter: limiter });
+  }
+
+  it('should refuse calls over the cap on calls in flight', function (done) {
+    const limiter = new ffi.Limiter({ maxInFlight: 2 });
+    const sleep = sleeper(limiter);
+    let pending = 2;
+    for (let i = 0; i < 2; i++) {
+      sleep.async(10, function (err) {
+        assert.strictEqual(null, err);
+        if (--pending > 0) return;
+        const stats = limiter.stats();
+        assert.strictEqual(0, stats.inFlight);
+        assert.strictEqual(2, stats.completed);
+        assert.strictEqual(2, stats.refused);
+        done();
+      });
+    }
+    assert.throws(function () {
+      sleep.async(10, function () {});
+    }, function (err) {
+      return err.code === 'ERR_FFI_QUEUE_FULL';
+    });
+    sleep.async(10).then(function () {
+      done(new Error('expected a rejection'));
+    }, function (err) {
+      assert.strictEqual('ERR_FFI_QUEUE_FULL', err.code);
+    });
+    assert.strictEqual(2, limiter.stats().inFlight);
+  });
+
+  it('should refuse calls over the cap on queued calls', function () {
+    const limiter = new ffi.Limiter({ maxQueued: 1 });
+    const box = require('ref-struct-di')(ref)({ width: 'int', height: 'int' });
+    // takes the JS-land path
+    const area = ffi.ForeignFunction(bindings.area_box, 'int', [ box ], undefined,
+      { executor: 'test-limits', limiter: limiter });
+    const b = new box({ width: 2, height: 3 });
+    const calls = [ sleeper(limiter).async(20) ];
+    // the first one may or may not have been picked up yet
+    let refused = 0;
+    for (let i = 0; i < 3; i++) {
+      calls.push(area.async(b).catch(function (err) {
+        assert.strictEqual('ERR_FFI_QUEUE_FULL', err.code);
+        refused++;
+      }));
+    }
+    return Promise.all(calls).then(function () {
+      assert(refused >= 2);
+      assert.strictEqual(refused, limiter.stats().refused);
+    });
+  });
+
+  it('should signal backpressure instead of refusing calls', function (done) {
+    let drained = false;
+    const limiter = new ffi.Limiter({
+      maxInFlight: 2,
+      onFull: 'backpressure',
+      onDrain: function () {
+        drained = true;
+      }
+    });
+    const sleep = sleeper(limiter);
+    let pending = 3;
+    for (let i = 0; i < 3; i++) {
+      sleep.async(5, function (err) {
+        assert.strictEqual(null, err);
+        if (--pending > 0) return;
+        assert(drained);
+        assert.strictEqual(false, limiter.full);
+        assert.strictEqual(0, limiter.stats().refused);
+        done();
+      });
+      assert.strictEqual(i >= 1, limiter.full);
+    }
+  });
+
+  it('should report queue wait and run time percentiles', function () {
+    const limiter = new ffi.Limiter();
+    const sleep = sleeper(limiter);
+    const calls = [];
+    for (let i = 0; i < 4; i++) {
+      calls.push(sleep.async(20));
+    }
+    return Promise.all(calls).then(function () {
+      const stats = limiter.stats(true);
+      assert.strictEqual(4, stats.completed);
+      assert(stats.runTime.p50 >= 15, 'run time ' + stats.runTime.p50);
+      assert(stats.runTime.p99 >= stats.runTime.p50);
+      // the last one waited for the other three
+      assert(stats.queueWait.p99 >= 40, 'queue wait ' + stats.queueWait.p99);
+      assert.strictEqual(0, limiter.stats().completed);
+    });
+  });
+
+  it('should apply the global caps to all the calls', function () {
+    const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+    const before = ffi.limits.stats().completed;
+    ffi.limits.configure({ maxInFlight: 1 });
+    try {
+      const call = abs.async(-1);
+      assert.throws(function () {
+        abs.async(-2, function () {});
+      }, /Too many async calls in flight/);
+      return call.then(function (res) {
+        assert.strictEqual(1, res);
+        assert(ffi.limits.stats().completed > before);
+      });
+    } finally {
+      ffi.limits.configure();
+    }
+  });
+});
@@ -0,0 +1,116 @@
+'use strict';
+const assert = require('assert');
+const ffi = require('../');
+const bindings = require('node-gyp-build')(__dirname);
+
+describe('Ring', function () {
+  afterEach(global.gc);
+
+  const abs = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ]);
+  const add = ffi.ForeignFunction(bindings.add_int64, 'int64', [ 'int64', 'int64' ]);
+  const scale = ffi.ForeignFunction(bindings.scale_float, 'float', [ 'float', 'int32' ]);
+  const ENOENT = 2;
+
+  it('should run the submitted calls and deliver their results', function (done) {
+    const results = new Map();
+    const ring = new ffi.Ring([ abs, add ], {
+      entries: 64,
+      onCompletion: function (tag, err, result) {
+        assert.strictEqual(0, err);
+        results.set(tag, result);
+        if (results.size < 40) return;
+        for (let i = 0; i < 20; i++) {
+          assert.strictEqual(i, results.get(i));
+          assert.strictEqual(i * 3, results.get(100 + i));
+        }
+        done();
+      }
+    });
+    for (let i = 0; i < 20; i++) {
+      assert(ring.submit(0, i, -i));
+      assert(ring.submit(1, 100 + i, i, 2 * i));
+    }
+    ring.flush();
+  });
+
+  it('should pass floating point arguments and results', function (done) {
+    const ring = new ffi.Ring([ scale ], {
+      onCompletion: function (tag, err, result) {
+        assert.strictEqual(7, tag);
+        assert.strictEqual(scale(1.5, 2), result);
+        done();
+      }
+    });
+    ring.submit(0, 7, 1.5, 2);
+    ring.flush();
+  });
+
+  it('should refuse submissions when it is full', function (done) {
+    const ring = new ffi.Ring([ abs ], { entries: 4 });
+    for (let i = 0; i < 4; i++) {
+      assert(ring.submit(0, i, -i));
+    }
+    assert.strictEqual(false, ring.submit(0, 4, -4));
+    assert.strictEqual(4, ring.pending());
+    ring.flush();
+
+    // polling without being woken up
+    const tags = [];
+    (function poll () {
+      ring.poll((tag) => tags.push(tag));
+      if (tags.length < 4) return setTimeout(poll, 1);
+      assert.deepStrictEqual([ 0, 1, 2, 3 ], tags);
+      assert(ring.submit(0, 4, -4));
+      done();
+    })();
+  });
+
+  it('should report the errno of calls that fail their error policy', function (done) {
+    const fail = ffi.ForeignFunction(bindings.fail_with_errno, 'int', [ 'int' ], undefined,
+      { errorPolicy: 'negative' });
+    const ring = new ffi.Ring([ fail ], {
+      onCompletion: function (tag, err, result) {
+        if (tag === 0) {
+          assert.strictEqual(0, err);
+        } else {
+          assert.strictEqual(ENOENT, err);
+          assert.strictEqual(-1, result);
+          done();
+        }
+      }
+    });
+    ring.submit(0, 0, 0);
+    ring.submit(0, 1, ENOENT);
+    ring.flush();
+  });
+
+  it('should only take functions with native types', function () {
+    const box = require('ref-struct-di')(require('ref-napi'))({ width: 'int', height: 'int' });
+    const area = ffi.ForeignFunction(bindings.area_box, 'int', [ box ]);
+    assert.throws(function () {
+      ffi.Ring([ area ]);
+    }, /function 0 - expected a ForeignFunction/);
+    const atoi = ffi.ForeignFunction(bindings.atoi, 'int', [ 'string' ]);
+    assert.throws(function () {
+      ffi.Ring([ atoi ]);
+    }, /strings can't be passed through a ring/);
+    assert.throws(function () {
+      ffi.Ring([ abs ], { entries: 3 });
+    }, /power of 2/);
+  });
+
+  it('should not take functions of an executor or the libuv threadpool', function () {
+    const serial = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+      { executor: 'test-ring' });
+    const uv = ffi.ForeignFunction(bindings.abs, 'int', [ 'int' ], undefined,
+      { pool: 'uv' });
+    assert.throws(function () {
+      ffi.Ring([ abs, serial ]);
+    }, function (err) {
+      return err instanceof TypeError && /function 1 - functions of an executor/.test(err.message);
+    });
+    assert.throws(function () {
+      ffi.Ring([ uv ]);
+    }, TypeError);
+  });
+});